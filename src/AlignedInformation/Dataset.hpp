@@ -10,6 +10,7 @@
 
 #include "GenomeReader.h"
 #include "../CoverageBias/GenomeType.h"
+#include "../SequenceLineReader.h"
 
 static const int MIN_KMER_SIZE = 15; // TODO: Does it make sense to introduce a minimum k-mer size??? Yes it does. For example, I use it in FeatureExtractorCurrentBase.hpp.
 static const int MAX_KMER_SIZE = 35;
@@ -23,13 +24,12 @@ public:
 		minReadLength = 0;
 		hasQualityScores = false;
 		maxReadLength = 0;
+		readLengthsPtr = std::make_shared<std::unordered_map<size_t, size_t> >();
 	}
 
 	Dataset(const std::string &sra) {
 		hasQualityScores = true;
 		if (sra == "SRR396537") {
-			readsOnlyFileName =
-					"data/e_coli_k12_mg1655/Illumina_Genome_Analyzer_IIx/Nextera/GA091120/SRR396537/SRR396537_without_adapters.fastq.readsOnly.txt";
 			readsFileName =
 					"data/e_coli_k12_mg1655/Illumina_Genome_Analyzer_IIx/Nextera/GA091120/SRR396537/SRR396537_without_adapters.fastq";
 			referenceFileName = "data/e_coli_k12_mg1655/reference.fasta";
@@ -38,8 +38,6 @@ public:
 			plotPath = "plots/Illumina/SRR396537/SRR396537_";
 			genomeType = GenomeType::CIRCULAR;
 		} else if (sra == "SRR396536") {
-			readsOnlyFileName =
-					"data/e_coli_k12_mg1655/Illumina_Genome_Analyzer_IIx/Nextera/GA091120/SRR396536/SRR396536_without_adapters.fastq.readsOnly.txt";
 			readsFileName =
 					"data/e_coli_k12_mg1655/Illumina_Genome_Analyzer_IIx/Nextera/GA091120/SRR396536/SRR396536_without_adapters.fastq";
 			referenceFileName = "data/e_coli_k12_mg1655/reference.fasta";
@@ -48,7 +46,6 @@ public:
 			plotPath = "plots/Illumina/SRR396536/SRR396536_";
 			genomeType = GenomeType::CIRCULAR;
 		} else if (sra == "SRR1284073") {
-			readsOnlyFileName = "data/e_coli_k12_mg1655/PacBio/SRR1284073.fastq.readsOnly.txt";
 			readsFileName =
 					"data/e_coli_k12_mg1655/PacBio/SRR1284073.fastq";
 			referenceFileName = "data/e_coli_k12_mg1655/reference.fasta";
@@ -57,28 +54,24 @@ public:
 			plotPath = "plots/PacBio/SRR1284073/SRR1284073_";
 			genomeType = GenomeType::CIRCULAR;
 		} else if (sra == "ebola_pacbio_simulated") {
-			readsOnlyFileName = "data/Simulated Datasets/Ebola/PacBio/ebola_pacbio_simulated.fastq.readsOnly.txt";
 			readsFileName = "data/Simulated Datasets/Ebola/PacBio/ebola_pacbio_simulated.fastq";
 			referenceFileName = "data/Simulated Datasets/Ebola/reference.fasta";
 			readAlignmentsFileName = "data/Simulated Datasets/Ebola/PacBio/ebola_pacbio_simulated.bam";
 			plotPath = "plots/PacBio/ebola_simulated/ebola_pacbio_simulated_";
 			genomeType = GenomeType::LINEAR;
 		} else if (sra == "ebola_illumina_simulated") {
-			readsOnlyFileName = "data/Simulated Datasets/Ebola/Illumina/ebola_illumina_simulated.fastq.readsOnly.txt";
 			readsFileName = "data/Simulated Datasets/Ebola/Illumina/ebola_illumina_simulated.fastq";
 			referenceFileName = "data/Simulated Datasets/Ebola/reference.fasta";
 			readAlignmentsFileName = "data/Simulated Datasets/Ebola/Illumina/ebola_illumina_simulated.bam";
 			plotPath = "plots/Illumina/ebola_simulated/ebola_illumina_simulated_";
 			genomeType = GenomeType::LINEAR;
 		} else if (sra == "ecoli_pacbio_simulated") {
-			readsOnlyFileName = "data/Simulated Datasets/Ecoli/PacBio/ecoli_pacbio_simulated.fastq.readsOnly.txt";
 			readsFileName = "data/Simulated Datasets/Ecoli/PacBio/ecoli_pacbio_simulated.fastq";
 			referenceFileName = "data/Simulated Datasets/Ecoli/reference.fasta";
 			readAlignmentsFileName = "data/Simulated Datasets/Ecoli/PacBio/ecoli_pacbio_simulated.bam";
 			plotPath = "plots/PacBio/ecoli_simulated/ecoli_pacbio_simulated_";
 			genomeType = GenomeType::CIRCULAR;
 		} else if (sra == "ecoli_illumina_simulated") {
-			readsOnlyFileName = "data/Simulated Datasets/Ecoli/Illumina/ecoli_illumina_simulated.fastq.readsOnly.txt";
 			readsFileName = "data/Simulated Datasets/Ecoli/Illumina/ecoli_illumina_simulated.fastq";
 			referenceFileName = "data/Simulated Datasets/Ecoli/reference.fasta";
 			readAlignmentsFileName = "data/Simulated Datasets/Ecoli/Illumina/ecoli_illumina_simulated.bam";
@@ -91,9 +84,30 @@ public:
 		GenomeReader reader;
 		genome = reader.readGenome(referenceFileName);
 		genomeSize = length(genome);
-		countReadLengths();
+		readLengthsPtr = std::make_shared<std::unordered_map<size_t, size_t> >();
+		if (loadReadLengths(readsFileName, *readLengthsPtr)) {
+			updateReadLengths();
+		}
+	}
+
+	// Building the FM index of the reads stores their length histogram as a by-product, so this only reads the reads
+	// file if the index already existed without it.
+	void countReadLengths() {
+		if (!readLengthsPtr->empty() || loadReadLengths(readsFileName, *readLengthsPtr)) {
+			updateReadLengths();
+			return;
+		}
+		SequenceLineReader reader(readsFileName);
+		std::string line;
+		while (reader.nextLine(line)) {
+			if (line.size() > 0) {
+				(*readLengthsPtr)[line.size()]++;
+			}
+		}
+		storeReadLengths(readsFileName, *readLengthsPtr);
+		updateReadLengths();
 	}
-	std::string readsOnlyFileName;
+
 	std::string referenceFileName;
 	std::string readsFileName;
 	std::string readAlignmentsFileName;
@@ -110,25 +124,15 @@ public:
 	double acceptProb = 1.0;
 	std::string name;
 private:
-	void countReadLengths() {
+	void updateReadLengths() {
+		readLengths = *readLengthsPtr;
 		numReads = 0;
-		minReadLength = std::numeric_limits<size_t>::infinity();
+		minReadLength = std::numeric_limits<size_t>::max();
 		maxReadLength = 0;
-		std::ifstream infile(readsOnlyFileName);
-		std::string line;
-		while (std::getline(infile, line)) {
-			size_t s = line.size();
-			if (s > 0) {
-				if (readLengths.find(s) == readLengths.end()) {
-					readLengths[s] = 1;
-				} else {
-					readLengths[s]++;
-				}
-				minReadLength = std::min(minReadLength, s);
-				maxReadLength = std::max(maxReadLength, s);
-				numReads++;
-			}
+		for (auto kv : readLengths) {
+			minReadLength = std::min(minReadLength, kv.first);
+			maxReadLength = std::max(maxReadLength, kv.first);
+			numReads += kv.second;
 		}
-		readLengthsPtr = std::make_shared<std::unordered_map<size_t, size_t> >(readLengths);
 	}
 };
@@ -11,17 +11,17 @@
 
 #include <seqan/basic.h>
 #include <seqan/sequence.h>
+#include <algorithm>
 #include <cassert>
 #include <functional>
 #include <iostream>
 #include <fstream>
+#include <sstream>
 
 #include "../FASTQRead.h"
-#include "../ProducerConsumerPattern.hpp"
+#include "../OrderedCorrection.hpp"
 #include "CorrectedReadAligned.h"
 
-using namespace std::placeholders;
-
 ErrorDetectionUnit::ErrorDetectionUnit() {
 	ecEval = NULL;
 }
@@ -90,62 +90,54 @@ void ErrorDetectionUnit::correctReads(const seqan::Dna5String &reference) {
 	}
 }
 
-void ErrorDetectionUnit::correctReadsMultithreaded(const seqan::Dna5String &reference) {
-	outMtx = std::vector<std::mutex>(alignmentsFiles.size());
-	auto fpProduce = std::bind(&ErrorDetectionUnit::produceData, this, _1, _2);
-	auto fpConsume = std::bind(&ErrorDetectionUnit::consumeData, this, _1, _2);
-
+// The output is the same as the one of correctReads(). Profiles that can be merged are checked by every thread into its
+// own accumulator, the other observers and the evaluation check the reads in their order, in the calling thread.
+void ErrorDetectionUnit::correctReadsMultithreaded(const seqan::Dna5String &reference, size_t numThreads) {
 	genomePtr = std::make_shared<seqan::Dna5String>(reference);
-	ProducerConsumerPattern<ReadWithAlignments> pct(50, fpProduce, fpConsume);
-	pct.run(alignmentsFiles.size(), consumersPerFile * alignmentsFiles.size());
-
+	numThreads = std::max(numThreads, (size_t) 1);
+	ObserverAccumulators accumulators(observers, numThreads);
 	for (size_t i = 0; i < alignmentsFiles.size(); ++i) {
+		correctInFileOrder<ReadWithAlignments, CorrectedAlignedBatch>(*iterators[i], numThreads, "Error detection", 1,
+				[&](const std::vector<ReadWithAlignments> &reads, CorrectedAlignedBatch &batch, size_t workerId) {
+					correctBatch(reads, batch, accumulators.ofThread(workerId));
+				}, [&](CorrectedAlignedBatch &batch) {
+					outFilesCorrectedReads[i] << batch.fastq;
+					for (const CorrectedReadAligned &cra : batch.correctedReads) {
+						for (ErrorProfileUnit *observer : accumulators.getOrderedObservers()) {
+							observer->checkAligned(cra);
+						}
+						if (ecEval != NULL) {
+							ecEval->checkAligned(cra);
+						}
+					}
+				});
 		outFilesCorrectedReads[i].close();
 		//outFilesCorrections[i].close();
 	}
-	
+
+	accumulators.mergeIntoObservers();
 	for (size_t j = 0; j < observers.size(); ++j) {
 		observers[j]->finalize();
 	}
 }
 
-double ErrorDetectionUnit::produceData(std::vector<ReadWithAlignments> &buffer, size_t producerId) {
-	if (iterators[producerId]->hasReadsLeft()) {
-		std::vector<ReadWithAlignments> alignedReads = iterators[producerId]->next(maxBufferSize);
-		for (ReadWithAlignments rwa : alignedReads) {
-			if (rwa.records.size() == 1) {
-				buffer.push_back(rwa);
-			}
-		}
-	}
-
-	return iterators[producerId]->progress();
-}
-
-void ErrorDetectionUnit::consumeData(std::vector<ReadWithAlignments> &buffer, size_t consumerId) {
+// Only uniquely mapped reads are corrected, as in correctReads().
+void ErrorDetectionUnit::correctBatch(const std::vector<ReadWithAlignments> &reads, CorrectedAlignedBatch &batch,
+		std::vector<std::unique_ptr<ErrorProfileUnit> > &threadAccumulators) {
 	assert(genomePtr != NULL);
-	for (ReadWithAlignments alignedRead : buffer) {
+	std::stringstream ss;
+	for (ReadWithAlignments alignedRead : reads) {
+		if (alignedRead.records.size() != 1) {
+			continue;
+		}
 		CorrectedReadAligned cra = alignedRead.retrieveCorrectedRead(*genomePtr.get());
-
-		std::string correctedReadString;
-		std::string craString;
-
-		for (size_t j = 0; j < observers.size(); ++j) {
-			observers[j]->checkAligned(cra);
+		ss << cra.correctedRead << "\n";
+		for (size_t j = 0; j < threadAccumulators.size(); ++j) {
+			threadAccumulators[j]->checkAligned(cra);
 		}
-
-		std::stringstream ss;
-		ss << cra.correctedRead;
-		correctedReadString = ss.str();
-
-		std::lock_guard<std::mutex> lck(outMtx[consumerId / consumersPerFile]);
-
-		outFilesCorrectedReads[consumerId / consumersPerFile] << correctedReadString << "\n";
-		//if (cra.corrections.size() > 0) {
-			//cereal::BinaryOutputArchive oarchive(outFilesCorrections[consumerId / consumersPerFile]);
-			//oarchive(cra);
-		//}
+		batch.correctedReads.push_back(std::move(cra));
 	}
+	batch.fastq = ss.str();
 }
 
 void ErrorDetectionUnit::addObserver(ErrorProfileUnit &epuObs) {
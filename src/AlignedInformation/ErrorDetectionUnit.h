@@ -12,11 +12,11 @@
 #include <stddef.h>
 #include <fstream>
 #include <memory>
-#include <mutex>
 #include <string>
 #include <vector>
 
 #include "../ErrorCorrectionEvaluation.h"
+#include "CorrectedReadAligned.h"
 #include "ReadWithAlignments.h"
 
 #include "BAMIterator.h"
@@ -35,23 +35,24 @@ public:
 	void addAlignmentsFile(const std::string &alignmentFilePath);
 	void addAlignmentsFile(const std::string &alignmentFilePath, const std::string &outputPath);
 	void correctReads(const seqan::Dna5String &reference);
-	void correctReadsMultithreaded(const seqan::Dna5String &reference);
+	void correctReadsMultithreaded(const seqan::Dna5String &reference, size_t numThreads);
 
 	void addObserver(ErrorProfileUnit& epuObs);
 private:
-	double produceData(std::vector<ReadWithAlignments> &buffer, size_t producerId);
-	void consumeData(std::vector<ReadWithAlignments> &buffer, size_t consumerId);
+	// the uniquely mapped reads of consecutive reads of an alignments file after their correction
+	struct CorrectedAlignedBatch {
+		std::string fastq; // the corrected reads, as they are written to the output file
+		std::vector<CorrectedReadAligned> correctedReads;
+	};
+	void correctBatch(const std::vector<ReadWithAlignments> &reads, CorrectedAlignedBatch &batch,
+			std::vector<std::unique_ptr<ErrorProfileUnit> > &threadAccumulators);
 
 	std::vector<std::string> alignmentsFiles;
 	std::vector<std::ofstream> outFilesCorrectedReads;
 	//std::vector<std::ofstream> outFilesCorrections;
-	std::vector<std::mutex> outMtx;
 	std::vector<std::unique_ptr<BAMIterator> > iterators;
 	std::shared_ptr<seqan::Dna5String> genomePtr;
 
 	std::vector<ErrorProfileUnit*> observers;
 	ErrorCorrectionEvaluation* ecEval;
-
-	size_t consumersPerFile = 3;
-	size_t maxBufferSize = consumersPerFile * 2;
 };
@@ -0,0 +1,54 @@
+/*
+ * AllocationCounter.cpp
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: sarah
+ */
+
+#include "AllocationCounter.h"
+
+#include <cstdlib>
+#include <new>
+
+#ifdef PAEC_COUNT_ALLOCATIONS
+
+static thread_local size_t numAllocations = 0;
+
+size_t numHeapAllocations() {
+	return numAllocations;
+}
+
+static void* countedAllocation(size_t size) {
+	numAllocations++;
+	void *ptr = std::malloc(size == 0 ? 1 : size);
+	if (!ptr) {
+		throw std::bad_alloc();
+	}
+	return ptr;
+}
+
+void* operator new(size_t size) {
+	return countedAllocation(size);
+}
+
+void* operator new[](size_t size) {
+	return countedAllocation(size);
+}
+
+void operator delete(void *ptr) noexcept {
+	std::free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept {
+	std::free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept {
+	std::free(ptr);
+}
+
+void operator delete[](void *ptr, size_t) noexcept {
+	std::free(ptr);
+}
+
+#endif
@@ -0,0 +1,19 @@
+/*
+ * AllocationCounter.h
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: sarah
+ */
+
+#pragma once
+
+#include <stddef.h>
+
+/*
+ * If built with -DPAEC_COUNT_ALLOCATIONS, the global operator new is replaced by one that counts the heap allocations
+ * of every thread, so that experiments can check that a code path allocates no heap memory. Counting costs one
+ * increment of a thread-local variable. Other builds keep the allocator of the standard library.
+ */
+#ifdef PAEC_COUNT_ALLOCATIONS
+size_t numHeapAllocations(); // of the calling thread so far
+#endif
@@ -7,20 +7,27 @@
 
 #pragma once
 
+#include <chrono>
 #include <functional>
 #include <memory>
+#include <thread>
 
+#include "AllocationCounter.h"
 #include "AlignedInformation/Dataset.hpp"
 #include "AlignedInformation/ErrorDetectionUnit.h"
 #include "CorrectedRead.h"
 #include "CoverageBias/PUSM.h"
 #include "ErrorCorrection/ErrorCorrectionUnit.h"
+#include "ErrorCorrection/ReadKmerProfile.h"
 #include "ErrorProfile/machine_learning/ClassifierErrorProfile.h"
 #include "ErrorProfile/motif_analysis/MotifErrorProfile.h"
 #include "ErrorProfile/OverallErrorProfile.h"
+#include "FASTQIterator.h"
 #include "FASTQRead.h"
+#include "SequenceLineReader.h"
 #include "KmerClassification/KmerClassificationUnit.h"
 #include "KmerClassification/KmerCounter.h"
+#include "KmerClassification/PackedKmer.h"
 #include "ErrorCorrectionEvaluation.h"
 
 #include "external/gnuplot-iostream.h"
@@ -35,7 +42,8 @@ class ComponentSetup {
 public:
 	ComponentSetup(Dataset &ds, CoverageBiasType coverageBiasType, KmerClassificationType classificationType,
 			ErrorProfileType errorProfileType, ErrorCorrectionType corrType, bool indels) :
-			dataset(ds), counterReads(ds.readsOnlyFileName), counterReference(ds.referenceFileName), pusm(
+			dataset(ds), counterReads(ds.readsFileName, IndexStrandMode::BOTH_STRANDS), counterReference(
+					ds.referenceFileName, IndexStrandMode::FORWARD_ONLY), pusm(
 					ds.readLengthsPtr, ds.genomeSize, ds.genomeType), covBias(coverageBiasType, ds.genomeSize, pusm), kmerClassifier(
 					counterReads, counterReference, covBias, pusm, classificationType), epuMotif(counterReads), epuMotif2(counterReads), epuClassify(
 					ds.plotPath, coverageBiasType, kmerClassifier, epuMotif, ds.hasQualityScores), epuClassify2(
@@ -46,6 +54,17 @@ public:
 		correctionType = corrType;
 		correctIndels = indels;
 
+		// known now at the latest, because building the reads index stores the read lengths
+		dataset.countReadLengths();
+
+		// most k-mers are counted at exactly the minimum k-mer size
+		counterReads.enableFixedSizeTable(covBias.getMinKmerSize());
+		// the variants of those k-mers after a single insertion or deletion are often absent from the reads
+		counterReads.enablePrefilter( { covBias.getMinKmerSize() - 1, covBias.getMinKmerSize() + 1 });
+		// validation runs classify by the reference, whose k-mers of the most frequent sizes fit into memory
+		kmerClassifier.enableReferenceTable(dataset.genome,
+				{ covBias.getMinKmerSize() - 1, covBias.getMinKmerSize(), covBias.getMinKmerSize() + 1 });
+
 		edu = ErrorDetectionUnit(ece);
 
 		if (profileType == ErrorProfileType::MACHINE_LEARNING) {
@@ -79,6 +98,9 @@ public:
 			biasTypeTitle = "median_bias_reads";
 		}
 
+		// k-mers classified so far have been classified without the bias
+		kmerClassifier.clearCache();
+
 		std::ifstream infile(dataset.plotPath + "coverageBias." + biasTypeTitle + ".txt");
 		if (infile.good()) {
 			std::cout << "Coverage bias has been already learned. Loading learned values instead.\n";
@@ -218,6 +240,128 @@ public:
 				<< std::endl;
 	}
 
+	// compares counting the k-mers of the first reads one after the other with counting them in batches
+	void experimentBatchedCounting() {
+		size_t k = kmerClassifier.getMinKmerSize();
+		std::vector<std::string> kmers;
+		FASTQIterator it(dataset.readsFileName);
+		while (it.hasReadsLeft() && kmers.size() < 1000000) {
+			std::vector<FASTQRead> reads = it.next(1000);
+			for (FASTQRead read : reads) {
+				for (size_t i = 0; i + k <= read.sequence.size(); ++i) {
+					kmers.push_back(read.sequence.substr(i, k));
+				}
+			}
+		}
+		std::cout << "Counting " << kmers.size() << " k-mers of size " << k << "...\n";
+
+		std::function<size_t(const std::string&)> countReads = std::bind(&KmerCounter::countKmer, &counterReads, _1);
+		std::function<std::vector<size_t>(const std::vector<std::string>&)> countReadsBatch = std::bind(
+				&KmerCounter::countKmers, &counterReads, _1);
+		compareBatchedCounting("reads index", kmers, countReads, countReadsBatch);
+
+		std::function<size_t(const std::string&)> countRef = std::bind(&KmerCounter::countKmerNoRC, &counterReference,
+				_1);
+		std::function<std::vector<size_t>(const std::vector<std::string>&)> countRefBatch = std::bind(
+				&KmerCounter::countKmersNoRC, &counterReference, _1);
+		compareBatchedCounting("reference index, forward strand only", kmers, countRef, countRefBatch);
+	}
+
+	// builds every FM index variant over the given reads file and reports its size and counting throughput
+	void experimentFMIndexVariants(const std::string &readsFile) {
+		size_t k = kmerClassifier.getMinKmerSize();
+		std::vector<std::string> kmers;
+		SequenceLineReader reader(readsFile);
+		std::string line;
+		while (reader.nextLine(line) && kmers.size() < 1000000) {
+			for (size_t i = 0; i + k <= line.size(); ++i) {
+				kmers.push_back(line.substr(i, k));
+			}
+		}
+		std::cout << "Benchmarking FM index variants with " << kmers.size() << " k-mers of size " << k << "...\n";
+
+		for (FMIndexType type : ALL_FM_INDEX_TYPES) {
+			KmerCounter counter(readsFile, IndexStrandMode::BOTH_STRANDS, type);
+
+			auto start = std::chrono::steady_clock::now();
+			size_t sumSingle = 0;
+			for (size_t i = 0; i < kmers.size(); ++i) {
+				sumSingle += counter.countKmer(kmers[i]);
+			}
+			double secondsSingle = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+			start = std::chrono::steady_clock::now();
+			size_t sumBatch = 0;
+			for (size_t i = 0; i < kmers.size(); i += 1000) {
+				std::vector<std::string> batch(kmers.begin() + i, kmers.begin() + std::min(i + 1000, kmers.size()));
+				std::vector<size_t> counts = counter.countKmers(batch);
+				for (size_t j = 0; j < counts.size(); ++j) {
+					sumBatch += counts[j];
+				}
+			}
+			double secondsBatch = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+			if (sumSingle != sumBatch) {
+				throw std::runtime_error("Batched counting returned different counts!");
+			}
+			std::cout << fmIndexTypeToString(type) << ": " << counter.indexSizeInMegaBytes() << " MiB, "
+					<< kmers.size() / secondsSingle << " single counts/s, " << kmers.size() / secondsBatch
+					<< " batched counts/s, sum of counts " << sumSingle << "\n";
+		}
+	}
+
+#ifdef PAEC_COUNT_ALLOCATIONS
+	// Classifies the correction candidates of the windows of the first reads twice, through the read profiles as the
+	// correction does. The second pass finds all classes in the cache, and checks that classifying candidates on a warm
+	// cache allocates no heap memory. This is all it checks: the profiles are built outside of the measurement, a pass
+	// on a cold cache still allocates while classifying the k-mers it misses, and the rest of correcting a read (the
+	// corrected read, its profile and the error probabilities) allocates as well.
+	void experimentCandidateAllocations() {
+		size_t k = kmerClassifier.getMinKmerSize();
+		if (k + 1 > MAX_PACKED_KMER_SIZE) {
+			std::cout << "The candidate k-mers of size " << k + 1 << " are not cached, skipping the experiment.\n";
+			return;
+		}
+		FASTQIterator it(dataset.readsFileName);
+		std::vector<FASTQRead> reads = it.next(1000);
+		std::string kmer;
+		kmer.reserve(k + 1);
+		for (size_t pass = 1; pass <= 2; ++pass) {
+			std::vector<ReadKmerProfile> profiles;
+			profiles.reserve(reads.size());
+			for (const FASTQRead &read : reads) {
+				profiles.emplace_back(read.sequence, kmerClassifier);
+			}
+			size_t numKmers = 0;
+			size_t numCandidates = 0;
+			size_t allocationsBefore = numHeapAllocations();
+			auto start = std::chrono::steady_clock::now();
+			for (size_t r = 0; r < reads.size(); ++r) {
+				const std::string &sequence = reads[r].sequence;
+				for (size_t i = 0; i + k <= sequence.size(); ++i) {
+					kmer.assign(sequence, i, k);
+					if (kmer.find_first_not_of("ACGT") != std::string::npos) {
+						continue;
+					}
+					ErrorTypeSet repetitive;
+					ErrorTypeSet trusted = classifyCandidates(kmer, k / 2, kmerClassifier, repetitive, &profiles[r],
+							i);
+					numKmers++;
+					numCandidates += trusted.size() + repetitive.size();
+				}
+			}
+			double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			size_t numAllocations = numHeapAllocations() - allocationsBefore;
+			std::cout << "Pass " << pass << (pass == 1 ? " (cold cache): " : " (warm cache): ") << numKmers / seconds
+					<< " k-mers/s, " << numCandidates << " candidates, " << numAllocations
+					<< " heap allocations while classifying candidates\n";
+			if (pass == 2 && numAllocations > 0) {
+				throw std::runtime_error("Classifying correction candidates on a warm cache allocated heap memory!");
+			}
+		}
+	}
+#endif
+
 	void trainKmerClassification() {
 		if (clsfyType != KmerClassificationType::CLASSIFICATION_MACHINE_LEARNING) {
 			return;
@@ -244,8 +388,7 @@ public:
 			std::cout << "Errors have already been extracted. Skipping error extraction.\n";
 		} else {
 			edu.addAlignmentsFile(dataset.readAlignmentsFileName, dataset.plotPath);
-			edu.correctReads(dataset.genome);
-			//edu.correctReadsMultithreaded(dataset.genome);
+			edu.correctReadsMultithreaded(dataset.genome, std::max(1u, std::thread::hardware_concurrency()));
 
 			if (profileType == ErrorProfileType::OVERALL_STATS_ONLY) {
 				epuOverall.plotErrorProfile();
@@ -318,12 +461,32 @@ public:
 		}
 	}
 
+	// identical reads are corrected once, by default every read is corrected on its own
+	void enableReadDeduplication(ReadDeduplicationMode mode) {
+		ecu.enableReadDeduplication(mode);
+	}
+
 	void correctReads() {
+		// the coverage bias is final now, so the classification can be reduced to count thresholds
+		kmerClassifier.compileThresholds(dataset.maxReadLength);
+		// most k-mers have the minimum size, their classes are computed once per reads dataset and configuration
+		kmerClassifier.enableClassTable();
+		if (correctionType == ErrorCorrectionType::DE_BRUIJN) {
+			kmerClassifier.enableSolidKmerGraph();
+		}
 		ecu.addReadsFile(dataset.readsFileName, dataset.plotPath);
 		std::cout << "Correcting reads, Part 1...\n";
-		//ecu.correctReadsMultithreaded();
-		ecu.correctReads();
+		ecu.correctReadsMultithreaded(numCorrectionThreads());
 		std::cout << "Finished correcting reads.\n";
+#ifdef PAEC_VERIFY_THRESHOLDS
+		if (!kmerClassifier.verifyThresholds()) {
+			throw std::runtime_error("The compiled count thresholds disagree with the floating-point classification!");
+		}
+#endif
+		std::cout << "K-mer prefilter skipped " << counterReads.getNumSkippedSearches() << " of "
+				<< counterReads.getNumPrefilterQueries() << " filtered FM index searches.\n";
+		std::cout << "K-mer classification cache: " << kmerClassifier.getCache().getNumHits() << " hits, "
+				<< kmerClassifier.getCache().getNumMisses() << " misses.\n";
 
 		/*
 		std::cout << "Correcting reads, Part 2...\n";
@@ -359,6 +522,42 @@ public:
 	ErrorCorrectionUnit ecu;
 	ErrorCorrectionEvaluation ece;
 private:
+	// the machine learning error profile and the Python k-mer classifier can only be used by one thread at a time
+	size_t numCorrectionThreads() {
+		if (profileType == ErrorProfileType::MACHINE_LEARNING || !kmerClassifier.supportsConcurrentClassification()) {
+			return 1;
+		}
+		return std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	void compareBatchedCounting(const std::string &title, const std::vector<std::string> &kmers,
+			std::function<size_t(const std::string&)> countSingle,
+			std::function<std::vector<size_t>(const std::vector<std::string>&)> countBatch) {
+		auto start = std::chrono::steady_clock::now();
+		size_t sumSingle = 0;
+		for (size_t i = 0; i < kmers.size(); ++i) {
+			sumSingle += countSingle(kmers[i]);
+		}
+		double secondsSingle = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		start = std::chrono::steady_clock::now();
+		size_t sumBatch = 0;
+		for (size_t i = 0; i < kmers.size(); i += 1000) { // batches of roughly the size of all windows of a read
+			std::vector<std::string> batch(kmers.begin() + i, kmers.begin() + std::min(i + 1000, kmers.size()));
+			std::vector<size_t> counts = countBatch(batch);
+			for (size_t j = 0; j < counts.size(); ++j) {
+				sumBatch += counts[j];
+			}
+		}
+		double secondsBatch = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		if (sumSingle != sumBatch) {
+			throw std::runtime_error("Batched counting returned different counts!");
+		}
+		std::cout << title << ": single counts " << secondsSingle << " s, batched counts " << secondsBatch
+				<< " s, speedup " << secondsSingle / secondsBatch << "\n";
+	}
+
 	CoverageBiasType covBiasType;
 	KmerClassificationType clsfyType;
 	ErrorProfileType profileType;
@@ -280,32 +280,37 @@ void CoverageBiasUnit::learnBiasFromReadsOnly(const std::string &readsFilePath,
 	FASTQIterator it(readsFilePath);
 	while (it.hasReadsLeft()) {
 		std::vector<FASTQRead> reads = it.next(100);
+		// collect the unvisited k-mers of all reads in the chunk first, so that they can be counted as one batch
+		std::vector<std::string> kmers;
 		for (FASTQRead read : reads) {
 			std::string seq = read.sequence;
 			for (int i = 0; i < (int) seq.size() - (int) minKmerSize; ++i) {
 				std::string kmer = read.sequence.substr(i, minKmerSize);
 				if (visitedKmers.find(kmer) == visitedKmers.end()) {
-
-					double gc = 0;
-					for (size_t j = 0; j < kmer.size(); ++j) {
-						if (kmer[j] == 'G' || kmer[j] == 'C') {
-							gc++;
-						}
-					}
-					gc = gc / kmer.size();
-					size_t gcIndex = gc / gc_step;
-					size_t countObserved = readsCounter.countKmer(kmer);
-					double countExpected = pusm->expectedCount(kmer).first;
-					if (countObserved >= countExpected * 0.2) { // if this condition is left out, the coverage biases will be very low due to erroneous k-mers
-
-						double bias = (double) countObserved / countExpected;
-						allBiases[gcIndex].push_back(bias);
-					}
-
+					kmers.push_back(kmer);
 					visitedKmers.insert(kmer);
 				}
 			}
 		}
+		std::vector<size_t> counts = readsCounter.countKmers(kmers);
+		for (size_t k = 0; k < kmers.size(); ++k) {
+			const std::string &kmer = kmers[k];
+			double gc = 0;
+			for (size_t j = 0; j < kmer.size(); ++j) {
+				if (kmer[j] == 'G' || kmer[j] == 'C') {
+					gc++;
+				}
+			}
+			gc = gc / kmer.size();
+			size_t gcIndex = gc / gc_step;
+			size_t countObserved = counts[k];
+			double countExpected = pusm->expectedCount(kmer).first;
+			if (countObserved >= countExpected * 0.2) { // if this condition is left out, the coverage biases will be very low due to erroneous k-mers
+
+				double bias = (double) countObserved / countExpected;
+				allBiases[gcIndex].push_back(bias);
+			}
+		}
 
 		double progress = it.progress();
 		if (progress >= min_progress) {
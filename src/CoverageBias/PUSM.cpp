@@ -16,6 +16,15 @@ PerfectUniformSequencingModel::PerfectUniformSequencingModel(
 	genomeType = type;
 }
 
+PerfectUniformSequencingModel::PerfectUniformSequencingModel(const PerfectUniformSequencingModel &other) {
+	std::lock_guard<std::mutex> lck(other.expectedMtx);
+	readLengths = other.readLengths;
+	genomeSize = other.genomeSize;
+	genomeType = other.genomeType;
+	expectedLinear = other.expectedLinear;
+	expectedCircular = other.expectedCircular;
+}
+
 std::pair<double, double> PerfectUniformSequencingModel::expectedCount(const std::string &kmer) {
 	if (genomeType == GenomeType::CIRCULAR) {
 		return expectedCountCircular(kmer.size());
@@ -27,8 +36,12 @@ std::pair<double, double> PerfectUniformSequencingModel::expectedCount(const std
 std::pair<double, double> PerfectUniformSequencingModel::expectedCountCircular(size_t k) {
 	double expected = 0.0;
 	double variance = 0.0;
-	if (expectedCircular.find(k) != expectedCircular.end()) {
-		return expectedCircular[k];
+	{
+		std::lock_guard<std::mutex> lck(expectedMtx);
+		auto it = expectedCircular.find(k);
+		if (it != expectedCircular.end()) {
+			return it->second;
+		}
 	}
 	for (auto pair : (*readLengths.get())) {
 		double l = pair.first;
@@ -43,6 +56,7 @@ std::pair<double, double> PerfectUniformSequencingModel::expectedCountCircular(s
 		variance += n * p * (1 - p);
 	}
 	std::pair<double, double> res = std::make_pair(expected, sqrt(variance));
+	std::lock_guard<std::mutex> lck(expectedMtx);
 	expectedCircular[k] = res;
 	return res;
 }
@@ -50,8 +64,12 @@ std::pair<double, double> PerfectUniformSequencingModel::expectedCountCircular(s
 std::pair<double, double> PerfectUniformSequencingModel::expectedCountLinear(size_t k) {
 	double expected = 0.0;
 	double variance = 0.0;
-	if (expectedLinear.find(k) != expectedLinear.end()) {
-		return expectedLinear[k];
+	{
+		std::lock_guard<std::mutex> lck(expectedMtx);
+		auto it = expectedLinear.find(k);
+		if (it != expectedLinear.end()) {
+			return it->second;
+		}
 	}
 	for (auto pair : (*readLengths.get())) {
 		double l = pair.first;
@@ -71,6 +89,7 @@ std::pair<double, double> PerfectUniformSequencingModel::expectedCountLinear(siz
 		variance += n * p * (1 - p);
 	}
 	std::pair<double, double> res = std::make_pair(expected, sqrt(variance));
+	std::lock_guard<std::mutex> lck(expectedMtx);
 	expectedLinear[k] = res;
 	return res;
 }
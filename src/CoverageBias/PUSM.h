@@ -12,6 +12,7 @@
 #include <string>
 #include <unordered_map>
 #include <memory>
+#include <mutex>
 #include <utility>
 
 #include "GenomeType.h"
@@ -20,6 +21,7 @@ class PerfectUniformSequencingModel {
 public:
 	PerfectUniformSequencingModel(std::shared_ptr<std::unordered_map<size_t, size_t> > &readLengthsPtr,
 			size_t estimatedGenomeSize, GenomeType &type);
+	PerfectUniformSequencingModel(const PerfectUniformSequencingModel &other);
 	std::pair<double, double> expectedCount(const std::string &kmer);
 private:
 	std::pair<double, double> expectedCountLinear(size_t k);
@@ -30,5 +32,6 @@ private:
 	GenomeType genomeType;
 	std::unordered_map<size_t, std::pair<double, double> > expectedLinear;
 	std::unordered_map<size_t, std::pair<double, double> > expectedCircular;
+	mutable std::mutex expectedMtx; // guards the memoized expectations, reads are corrected concurrently
 };
 
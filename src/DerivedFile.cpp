@@ -0,0 +1,63 @@
+/*
+ * DerivedFile.cpp
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: sarah
+ */
+
+#include "DerivedFile.h"
+
+#include <cstdio>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <unistd.h>
+
+TextFileStamp stampOfFile(const std::string &filepath) {
+	TextFileStamp stamp = { 0, 0 };
+	struct stat st;
+	if (stat(filepath.c_str(), &st) == 0) {
+		stamp.size = st.st_size;
+		stamp.mtimeNanos = (int64_t) st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+	}
+	return stamp;
+}
+
+bool operator==(const TextFileStamp &lhs, const TextFileStamp &rhs) {
+	return lhs.size == rhs.size && lhs.mtimeNanos == rhs.mtimeNanos;
+}
+
+bool operator!=(const TextFileStamp &lhs, const TextFileStamp &rhs) {
+	return !(lhs == rhs);
+}
+
+// the process id keeps processes that build the same file at the same time from writing into each other's file
+DerivedFileWriter::DerivedFileWriter(const std::string &filepath) :
+		filepath(filepath), tmpFilepath(filepath + "." + std::to_string(getpid()) + ".tmp"),
+		outfile(tmpFilepath, std::ios::binary) {
+	committed = false;
+	if (!outfile.good()) {
+		throw std::runtime_error("Could not create file: " + tmpFilepath);
+	}
+}
+
+DerivedFileWriter::~DerivedFileWriter() {
+	if (!committed) {
+		outfile.close();
+		std::remove(tmpFilepath.c_str());
+	}
+}
+
+std::ofstream& DerivedFileWriter::stream() {
+	return outfile;
+}
+
+void DerivedFileWriter::commit() {
+	outfile.close();
+	if (outfile.fail()) {
+		throw std::runtime_error("Could not write file: " + tmpFilepath);
+	}
+	if (std::rename(tmpFilepath.c_str(), filepath.c_str()) != 0) {
+		throw std::runtime_error("Could not rename " + tmpFilepath + " to " + filepath);
+	}
+	committed = true;
+}
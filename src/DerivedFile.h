@@ -0,0 +1,45 @@
+/*
+ * DerivedFile.h
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: sarah
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+/*
+ * Identifies the version of a text file that other files (indexes, tables, histograms) have been derived from, by its
+ * size and modification time. A derived file stores the stamp of its text file and is stale once the stamps differ.
+ */
+struct TextFileStamp {
+	uint64_t size;
+	int64_t mtimeNanos;
+};
+
+TextFileStamp stampOfFile(const std::string &filepath); // all zero if the file does not exist
+bool operator==(const TextFileStamp &lhs, const TextFileStamp &rhs);
+bool operator!=(const TextFileStamp &lhs, const TextFileStamp &rhs);
+
+/*
+ * Writes a derived file under a temporary name next to it and renames it into place once it is complete, so that other
+ * processes reading or mapping the file see either the old or the new one, but never a partially overwritten one.
+ * The temporary file is removed if commit() is not reached.
+ */
+class DerivedFileWriter {
+public:
+	DerivedFileWriter(const std::string &filepath);
+	~DerivedFileWriter();
+	DerivedFileWriter(const DerivedFileWriter&) = delete;
+	DerivedFileWriter& operator=(const DerivedFileWriter&) = delete;
+	std::ofstream& stream();
+	void commit();
+private:
+	std::string filepath;
+	std::string tmpFilepath;
+	std::ofstream outfile;
+	bool committed;
+};
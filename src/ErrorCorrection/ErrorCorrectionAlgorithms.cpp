@@ -1,5 +1,7 @@
 #include <stddef.h>
 #include <cassert>
+#include <cmath>
+#include <functional>
 #include <stdexcept>
 #include <string>
 #include <unordered_map>
@@ -13,36 +15,114 @@
 #include "../FASTQRead.h"
 #include "../KmerClassification/KmerClassificationUnit.h"
 #include "../KmerClassification/KmerType.h"
+#include "../KmerClassification/PackedKmer.h"
+#include "../KmerClassification/SolidKmerGraph.h"
+#include "ReadKmerProfile.h"
 
 
-std::vector<ErrorType> reasonableErrorTypes(std::string &kmer, size_t posInKmer) {
-	std::vector<ErrorType> res;
+ErrorTypeSet reasonableErrorTypes(const std::string &kmer, size_t posInKmer) {
+	ErrorTypeSet res;
 	assert(posInKmer < kmer.size());
 	if (kmer[posInKmer] != 'A') {
-		res.push_back(ErrorType::SUB_FROM_A);
+		res.insert(ErrorType::SUB_FROM_A);
 	}
 	if (kmer[posInKmer] != 'C') {
-		res.push_back(ErrorType::SUB_FROM_C);
+		res.insert(ErrorType::SUB_FROM_C);
 	}
 	if (kmer[posInKmer] != 'G') {
-		res.push_back(ErrorType::SUB_FROM_G);
+		res.insert(ErrorType::SUB_FROM_G);
 	}
 	if (kmer[posInKmer] != 'T') {
-		res.push_back(ErrorType::SUB_FROM_T);
+		res.insert(ErrorType::SUB_FROM_T);
 	}
 	if (kmer.size() > 1 && posInKmer < kmer.size() - 1) {
-		res.push_back(ErrorType::INSERTION);
+		res.insert(ErrorType::INSERTION);
 	}
 	if (posInKmer < kmer.size() - 1) {
-		res.push_back(ErrorType::DEL_OF_A);
-		res.push_back(ErrorType::DEL_OF_C);
-		res.push_back(ErrorType::DEL_OF_G);
-		res.push_back(ErrorType::DEL_OF_T);
-		//res.push_back(ErrorType::MULTIDEL);
+		res.insert(ErrorType::DEL_OF_A);
+		res.insert(ErrorType::DEL_OF_C);
+		res.insert(ErrorType::DEL_OF_G);
+		res.insert(ErrorType::DEL_OF_T);
+		//res.insert(ErrorType::MULTIDEL);
 	}
 	return res;
 }
 
+static bool isSubstitution(ErrorType errorType) {
+	return errorType == ErrorType::SUB_FROM_A || errorType == ErrorType::SUB_FROM_C || errorType == ErrorType::SUB_FROM_G
+			|| errorType == ErrorType::SUB_FROM_T;
+}
+
+// the base a substitution or a single-base deletion puts into the read
+static char baseOfError(ErrorType errorType) {
+	switch (errorType) {
+	case ErrorType::SUB_FROM_A:
+	case ErrorType::DEL_OF_A:
+		return 'A';
+	case ErrorType::SUB_FROM_C:
+	case ErrorType::DEL_OF_C:
+		return 'C';
+	case ErrorType::SUB_FROM_G:
+	case ErrorType::DEL_OF_G:
+		return 'G';
+	case ErrorType::SUB_FROM_T:
+	case ErrorType::DEL_OF_T:
+		return 'T';
+	default:
+		throw std::runtime_error("Multidel not supported yet!");
+	}
+}
+
+// Changes the k-mer in place as kmerAfterError does. A k-mer whose capacity exceeds its size is never reallocated.
+void applyErrorInPlace(std::string &kmer, ErrorType errorType, size_t posInKmer) {
+	if (errorType == ErrorType::INSERTION) {
+		kmer.erase(posInKmer, 1);
+	} else if (isSubstitution(errorType)) {
+		kmer[posInKmer] = baseOfError(errorType);
+	} else {
+		kmer.insert(posInKmer + 1, 1, baseOfError(errorType));
+	}
+}
+
+// Undoes applyErrorInPlace, originalBase is the base that was at posInKmer before.
+void revertErrorInPlace(std::string &kmer, ErrorType errorType, size_t posInKmer, char originalBase) {
+	if (errorType == ErrorType::INSERTION) {
+		kmer.insert(posInKmer, 1, originalBase);
+	} else if (isSubstitution(errorType)) {
+		kmer[posInKmer] = originalBase;
+	} else {
+		kmer.erase(posInKmer + 1, 1);
+	}
+}
+
+// Classifies the k-mer after each reasonable error at posInKmer, by editing it in place and reverting the edit
+// afterwards. Returns the errors after which it is trusted, and the ones after which it is repetitive in repetitive.
+// The k-mer needs a capacity of at least its size plus one, then no heap memory is allocated here as long as the
+// classes of all candidates are found in the profile or in the classification cache.
+// If the k-mer is the window at kmerStartPos of the profiled read, the substitutions are looked up in the profile.
+ErrorTypeSet classifyCandidates(std::string &kmer, size_t posInKmer, KmerClassificationUnit &kmerClassifier,
+		ErrorTypeSet &repetitive, ReadKmerProfile *profile, size_t kmerStartPos) {
+	ErrorTypeSet trusted;
+	repetitive = ErrorTypeSet();
+	char originalBase = kmer[posInKmer];
+	bool useProfile = (profile != NULL && kmer.size() == profile->getKmerSize());
+	for (ErrorType errorType : reasonableErrorTypes(kmer, posInKmer)) {
+		KmerType type;
+		if (!useProfile || !isSubstitution(errorType)
+				|| !profile->substitutionClass(kmerStartPos, posInKmer, baseOfError(errorType), type)) {
+			applyErrorInPlace(kmer, errorType, posInKmer);
+			type = kmerClassifier.classifyKmer(kmer);
+			revertErrorInPlace(kmer, errorType, posInKmer, originalBase);
+		}
+		if (type == KmerType::TRUSTED) {
+			trusted.insert(errorType);
+		} else if (type == KmerType::REPEAT) {
+			repetitive.insert(errorType);
+		}
+	}
+	return trusted;
+}
+
 std::string findReplacement(const std::string &kmer, ErrorType errorType, size_t posInKmer) {
 	std::string replacement;
 	if (errorType == ErrorType::SUB_FROM_A) {
@@ -130,30 +210,59 @@ std::pair<ErrorType, double> mostLikelyNextGap(std::unordered_map<ErrorType, dou
 	return std::make_pair(bestType, bestProb);
 }
 
-KmerType checkLeftOf(size_t pos, const CorrectedRead &corr, KmerClassificationUnit &kmerClassifier) {
+// applies the correction to the read and keeps the profile of its k-mers up to date
+static void applyProfiledCorrection(CorrectedRead &corr, ReadKmerProfile &profile, ErrorType errorType, size_t pos,
+		double prob) {
+	size_t sizeBefore = corr.correctedRead.sequence.size();
+	corr.applyCorrection(errorType, pos, prob);
+	profile.baseReplaced(pos, 1 + corr.correctedRead.sequence.size() - sizeBefore);
+}
+
+// Grows the k-mer of the cursor by up to maxPairs pairs of bases of the sequence until it is no longer REPEAT, either to
+// the right by the bases from position from on, or to the left by the bases in front of position from. The cursor is
+// left at the grown k-mer and the number of added bases is returned. The k-mer never grows over a gap.
+static size_t growCursorByPairs(KmerCursor &cursor, const std::string &sequence, size_t from, bool left, size_t maxPairs,
+		KmerClassificationUnit &kmerClassifier, KmerType &type) {
+	std::vector<KmerExtension> extensions;
+	std::vector<size_t> checkpoints;
+	extensions.reserve(2 * maxPairs);
+	checkpoints.reserve(maxPairs);
+	for (size_t i = 0; i < 2 * maxPairs; ++i) {
+		char base = left ? sequence[from - 1 - i] : sequence[from + i];
+		if (base == '_') {
+			break;
+		}
+		extensions.push_back( { base, left });
+		if (i % 2 == 1) {
+			checkpoints.push_back(i + 1);
+		}
+	}
+	size_t numExtended;
+	type = kmerClassifier.classifyGrowingKmer(cursor, extensions, checkpoints, numExtended);
+	return numExtended;
+}
+
+KmerType checkLeftOf(size_t pos, const CorrectedRead &corr, KmerClassificationUnit &kmerClassifier,
+		ReadKmerProfile &profile) {
 	KmerType type = KmerType::REPEAT;
 	if (pos >= kmerClassifier.getMinKmerSize()) {
-		std::string kmerString = corr.correctedRead.sequence.substr(pos - kmerClassifier.getMinKmerSize(),
-				kmerClassifier.getMinKmerSize());
+		const std::string &sequence = corr.correctedRead.sequence;
+		std::string kmerString = sequence.substr(pos - kmerClassifier.getMinKmerSize(), kmerClassifier.getMinKmerSize());
 		if (kmerString.find("_") != std::string::npos) {
 			return type;
 		}
-		type = kmerClassifier.classifyKmer(kmerString);
-		int i = pos - kmerClassifier.getMinKmerSize();
-		while (type == KmerType::REPEAT && i - 2 >= 0) {
-			if (corr.correctedRead.sequence[i - 1] == '_' || corr.correctedRead.sequence[i - 2] == '_') {
-				break;
-			}
-			kmerString = corr.correctedRead.sequence[i - 1] + kmerString;
-			kmerString = corr.correctedRead.sequence[i - 2] + kmerString;
-			type = kmerClassifier.classifyKmer(kmerString);
-			i -= 2;
+		type = profile.classAt(pos - kmerClassifier.getMinKmerSize());
+		if (type == KmerType::REPEAT) {
+			KmerCursor cursor = kmerClassifier.startCursor(kmerString);
+			size_t i = pos - kmerClassifier.getMinKmerSize();
+			growCursorByPairs(cursor, sequence, i, true, i / 2, kmerClassifier, type);
 		}
 	}
 	return type;
 }
 
-KmerType checkRightOf(size_t pos, const CorrectedRead &corr, KmerClassificationUnit &kmerClassifier) {
+KmerType checkRightOf(size_t pos, const CorrectedRead &corr, KmerClassificationUnit &kmerClassifier,
+		ReadKmerProfile &profile) {
 	KmerType type = KmerType::REPEAT;
 	std::string kmerString = corr.correctedRead.sequence.substr(pos + 1, kmerClassifier.getMinKmerSize());
 	if (kmerString.size() >= kmerClassifier.getMinKmerSize()) {
@@ -161,20 +270,16 @@ KmerType checkRightOf(size_t pos, const CorrectedRead &corr, KmerClassificationU
 			throw std::runtime_error("This should not happen,,");
 		}
 
-		std::string kmerString = corr.correctedRead.sequence.substr(pos + 1, kmerClassifier.getMinKmerSize());
+		const std::string &sequence = corr.correctedRead.sequence;
+		std::string kmerString = sequence.substr(pos + 1, kmerClassifier.getMinKmerSize());
 		if (kmerString.find("_") != std::string::npos) {
 			return type;
 		}
-		type = kmerClassifier.classifyKmer(kmerString);
-		int i = pos + kmerClassifier.getMinKmerSize();
-		while (type == KmerType::REPEAT && i + 2 < (int) corr.correctedRead.sequence.size()) {
-			if (corr.correctedRead.sequence[i + 1] == '_' || corr.correctedRead.sequence[i + 2] == '_') {
-				break;
-			}
-			kmerString = kmerString + corr.correctedRead.sequence[i + 1];
-			kmerString = kmerString + corr.correctedRead.sequence[i + 2];
-			type = kmerClassifier.classifyKmer(kmerString);
-			i += 2;
+		type = profile.classAt(pos + 1);
+		if (type == KmerType::REPEAT) {
+			KmerCursor cursor = kmerClassifier.startCursor(kmerString);
+			size_t i = pos + kmerClassifier.getMinKmerSize();
+			growCursorByPairs(cursor, sequence, i + 1, false, (sequence.size() - i - 1) / 2, kmerClassifier, type);
 		}
 	}
 	return type;
@@ -186,7 +291,7 @@ KmerType classifyMiddleWithPosAs(size_t posInRead, const std::string &sequence,
 	bool rightPossible = (posInRead <= sequence.size() - 2);
 
 	KmerType kmerType = KmerType::REPEAT;
-	std::string kmer = middle;
+	KmerCursor kmer = kmerClassifier.startCursor(middle);
 	size_t offsetLeft = 1;
 	size_t offsetRight = 1;
 	bool goLeft = leftPossible;
@@ -200,7 +305,7 @@ KmerType classifyMiddleWithPosAs(size_t posInRead, const std::string &sequence,
 				if (sequence[posInRead - offsetLeft] == '_') {
 					leftPossible = false;
 				} else {
-					kmer = sequence[posInRead - offsetLeft] + kmer;
+					kmer.extendLeft(sequence[posInRead - offsetLeft]);
 					if (kmer.size() >= kmerClassifier.getMinKmerSize() && kmer.size() % 2 == 1) {
 						KmerType type = kmerClassifier.classifyKmer(kmer);
 						if (type != KmerType::REPEAT) {
@@ -221,7 +326,7 @@ KmerType classifyMiddleWithPosAs(size_t posInRead, const std::string &sequence,
 				if (sequence[posInRead + offsetRight] == '_') {
 					rightPossible = false;
 				} else {
-					kmer = kmer + sequence[posInRead + offsetRight];
+					kmer.extendRight(sequence[posInRead + offsetRight]);
 					if (kmer.size() >= kmerClassifier.getMinKmerSize() && kmer.size() % 2 == 1) {
 						KmerType type = kmerClassifier.classifyKmer(kmer);
 						if (type != KmerType::REPEAT) {
@@ -248,7 +353,7 @@ KmerType classifyMiddleWithoutPos(size_t posInRead, const std::string &sequence,
 	bool rightPossible = (posInRead <= sequence.size() - 2);
 
 	KmerType kmerType = KmerType::REPEAT;
-	std::string kmer = "";
+	KmerCursor kmer = kmerClassifier.startCursor("");
 	size_t offsetLeft = 1;
 	size_t offsetRight = 1;
 	bool goLeft = leftPossible;
@@ -262,7 +367,7 @@ KmerType classifyMiddleWithoutPos(size_t posInRead, const std::string &sequence,
 				if (sequence[posInRead - offsetLeft] == '_') {
 					leftPossible = false;
 				} else {
-					kmer = sequence[posInRead - offsetLeft] + kmer;
+					kmer.extendLeft(sequence[posInRead - offsetLeft]);
 					if (kmer.size() >= kmerClassifier.getMinKmerSize() && kmer.size() % 2 == 1) {
 						KmerType type = kmerClassifier.classifyKmer(kmer);
 						if (type != KmerType::REPEAT) {
@@ -283,7 +388,7 @@ KmerType classifyMiddleWithoutPos(size_t posInRead, const std::string &sequence,
 				if (sequence[posInRead + offsetRight] == '_') {
 					rightPossible = false;
 				} else {
-					kmer = kmer + sequence[posInRead + offsetRight];
+					kmer.extendRight(sequence[posInRead + offsetRight]);
 					if (kmer.size() >= kmerClassifier.getMinKmerSize() && kmer.size() % 2 == 1) {
 						KmerType type = kmerClassifier.classifyKmer(kmer);
 						if (type != KmerType::REPEAT) {
@@ -310,8 +415,9 @@ bool resolveMultidel(CorrectedRead &corr, ErrorProfileUnit &errorProfile, KmerCl
 	bool doLeft = true;
 	KmerType typeMiddle = classifyMiddleWithoutPos(multidelPos, corr.correctedRead.sequence, kmerClassifier);
 
-	KmerType typeLeft = checkLeftOf(multidelPos, corr, kmerClassifier);
-	KmerType typeRight = checkRightOf(multidelPos, corr, kmerClassifier);
+	ReadKmerProfile profile(corr.correctedRead.sequence, kmerClassifier);
+	KmerType typeLeft = checkLeftOf(multidelPos, corr, kmerClassifier, profile);
+	KmerType typeRight = checkRightOf(multidelPos, corr, kmerClassifier, profile);
 
 	//std::string kmerLeft = corr.correctedRead.sequence.substr(multidelPos - kmerClassifier.getMinKmerSize(), kmerClassifier.getMinKmerSize());
 	//std::cout << "Fixing multidel with kmerLeft = " << kmerLeft << "\n";
@@ -354,15 +460,16 @@ bool resolveMultidel(CorrectedRead &corr, ErrorProfileUnit &errorProfile, KmerCl
 				ErrorType bestError = ranking[i].first;
 				std::string correctedKmer = kmerAfterError(kmerLeft, bestError, kmerLeft.size() - 1);
 
-				kmerType = kmerClassifier.classifyKmer(correctedKmer);
+				KmerCursor cursor = kmerClassifier.startCursor(correctedKmer);
+				kmerType = kmerClassifier.classifyKmer(cursor);
 				int j = std::max(0, (int) multidelPos - (int) kmerClassifier.getMinKmerSize());
 				while (kmerType == KmerType::REPEAT && j - 2 >= 0) {
 					if (corr.correctedRead.sequence[j - 1] == '_' || corr.correctedRead.sequence[j - 2] == '_') {
 						throw std::runtime_error("This should not happen");
 					}
-					correctedKmer = corr.correctedRead.sequence[j - 1] + correctedKmer;
-					correctedKmer = corr.correctedRead.sequence[j - 2] + correctedKmer;
-					kmerType = kmerClassifier.classifyKmer(correctedKmer);
+					cursor.extendLeft(corr.correctedRead.sequence[j - 1]);
+					cursor.extendLeft(corr.correctedRead.sequence[j - 2]);
+					kmerType = kmerClassifier.classifyKmer(cursor);
 					j -= 2;
 				}
 
@@ -403,15 +510,16 @@ bool resolveMultidel(CorrectedRead &corr, ErrorProfileUnit &errorProfile, KmerCl
 				ErrorType bestError = ranking[i].first;
 				std::string correctedKmer = kmerAfterError(kmerRight, bestError, -1);
 
-				kmerType = kmerClassifier.classifyKmer(correctedKmer);
+				KmerCursor cursor = kmerClassifier.startCursor(correctedKmer);
+				kmerType = kmerClassifier.classifyKmer(cursor);
 				int j = multidelPos + kmerClassifier.getMinKmerSize();
 				while (kmerType == KmerType::REPEAT && j + 2 < (int) corr.correctedRead.sequence.size()) {
 					if (corr.correctedRead.sequence[j + 1] == '_' || corr.correctedRead.sequence[j + 2] == '_') {
 						throw std::runtime_error("This should not happen");
 					}
-					correctedKmer = correctedKmer + corr.correctedRead.sequence[j + 1];
-					correctedKmer = correctedKmer + corr.correctedRead.sequence[j + 2];
-					kmerType = kmerClassifier.classifyKmer(correctedKmer);
+					cursor.extendRight(corr.correctedRead.sequence[j + 1]);
+					cursor.extendRight(corr.correctedRead.sequence[j + 2]);
+					kmerType = kmerClassifier.classifyKmer(cursor);
 					j += 2;
 				}
 
@@ -479,7 +587,7 @@ std::vector<std::pair<size_t, std::pair<ErrorType, double> > > retrieveRanking(
 
 // TODO: FIXME: Improve handling of multideletions here
 bool correctKmer(const std::string &kmer, size_t kmerStartPos, CorrectedRead &corr, ErrorProfileUnit &errorProfile,
-		KmerClassificationUnit &kmerClassifier, bool withMultidel, bool correctIndels) {
+		KmerClassificationUnit &kmerClassifier, bool withMultidel, bool correctIndels, ReadKmerProfile &profile) {
 	std::vector<std::unordered_map<ErrorType, double> > probs = errorProfile.getReadErrorProbabilitiesPartial(
 			corr.correctedRead, kmerStartPos, kmerStartPos + kmer.size() - 1);
 	assert(probs.size() == kmer.size());
@@ -522,8 +630,8 @@ bool correctKmer(const std::string &kmer, size_t kmerStartPos, CorrectedRead &co
 				continue;
 			}
 
-			KmerType typeLeft = checkLeftOf(kmerStartPos + i + 1, corr, kmerClassifier);
-			KmerType typeRight = checkRightOf(kmerStartPos + i, corr, kmerClassifier);
+			KmerType typeLeft = checkLeftOf(kmerStartPos + i + 1, corr, kmerClassifier, profile);
+			KmerType typeRight = checkRightOf(kmerStartPos + i, corr, kmerClassifier, profile);
 			if (typeLeft != KmerType::UNTRUSTED && typeRight != KmerType::UNTRUSTED) {
 				KmerType typeMiddle = classifyMiddleWithoutPos(kmerStartPos + i, corr.correctedRead.sequence,
 						kmerClassifier);
@@ -531,7 +639,7 @@ bool correctKmer(const std::string &kmer, size_t kmerStartPos, CorrectedRead &co
 					if (bestError == ErrorType::MULTIDEL) {
 						//std::string kmerLeft = corr.correctedRead.sequence.substr(i + kmerStartPos - kmerClassifier.getMinKmerSize(), kmerClassifier.getMinKmerSize());
 
-						corr.applyCorrection(ErrorType::MULTIDEL, i + kmerStartPos, errorProb);
+						applyProfiledCorrection(corr, profile, ErrorType::MULTIDEL, i + kmerStartPos, errorProb);
 
 						//std::cout << "Added multidel with kmerLeft = " << kmerLeft << "\n";
 
@@ -542,7 +650,7 @@ bool correctKmer(const std::string &kmer, size_t kmerStartPos, CorrectedRead &co
 							KmerType actType = classifyMiddleWithPosAs(kmerStartPos + i, corr.correctedRead.sequence,
 									kmerClassifier, "A");
 							if (actType == KmerType::TRUSTED) {
-								corr.applyCorrection(bestError, i + kmerStartPos, errorProb);
+								applyProfiledCorrection(corr, profile, bestError, i + kmerStartPos, errorProb);
 								foundNewError = true;
 								return foundNewError;
 							}
@@ -550,7 +658,7 @@ bool correctKmer(const std::string &kmer, size_t kmerStartPos, CorrectedRead &co
 							KmerType actType = classifyMiddleWithPosAs(kmerStartPos + i, corr.correctedRead.sequence,
 									kmerClassifier, "C");
 							if (actType == KmerType::TRUSTED) {
-								corr.applyCorrection(bestError, i + kmerStartPos, errorProb);
+								applyProfiledCorrection(corr, profile, bestError, i + kmerStartPos, errorProb);
 								foundNewError = true;
 								return foundNewError;
 							}
@@ -558,7 +666,7 @@ bool correctKmer(const std::string &kmer, size_t kmerStartPos, CorrectedRead &co
 							KmerType actType = classifyMiddleWithPosAs(kmerStartPos + i, corr.correctedRead.sequence,
 									kmerClassifier, "G");
 							if (actType == KmerType::TRUSTED) {
-								corr.applyCorrection(bestError, i + kmerStartPos, errorProb);
+								applyProfiledCorrection(corr, profile, bestError, i + kmerStartPos, errorProb);
 								foundNewError = true;
 								return foundNewError;
 							}
@@ -566,7 +674,7 @@ bool correctKmer(const std::string &kmer, size_t kmerStartPos, CorrectedRead &co
 							KmerType actType = classifyMiddleWithPosAs(kmerStartPos + i, corr.correctedRead.sequence,
 									kmerClassifier, "T");
 							if (actType == KmerType::TRUSTED) {
-								corr.applyCorrection(bestError, i + kmerStartPos, errorProb);
+								applyProfiledCorrection(corr, profile, bestError, i + kmerStartPos, errorProb);
 								foundNewError = true;
 								return foundNewError;
 							}
@@ -577,18 +685,34 @@ bool correctKmer(const std::string &kmer, size_t kmerStartPos, CorrectedRead &co
 		} else {
 			if (withMultidel)
 				continue;
-			std::string correctedKmer = kmerAfterError(kmer, bestError, i);
-			KmerType type = kmerClassifier.classifyKmer(correctedKmer);
+			KmerType type;
+			if (!isSubstitution(bestError) || kmer.size() != profile.getKmerSize()
+					|| !profile.substitutionClass(kmerStartPos, i, baseOfError(bestError), type)) {
+				type = kmerClassifier.classifyKmer(kmerAfterError(kmer, bestError, i));
+			}
+			std::string correctedKmer;
 
 			// extend the k-mer if it is repetitive now
 			size_t inc = 2;
+			KmerCursor cursor;
 			while (type == KmerType::REPEAT
 					&& kmerStartPos + kmerClassifier.getMinKmerSize() + inc < corr.correctedRead.sequence.size()) {
-				correctedKmer = corr.correctedRead.sequence.substr(kmerStartPos, kmerClassifier.getMinKmerSize() + inc);
-				if (correctedKmer.find("_") != std::string::npos) {
-					break;
+				if (inc == 2) {
+					correctedKmer = corr.correctedRead.sequence.substr(kmerStartPos,
+							kmerClassifier.getMinKmerSize() + inc);
+					if (correctedKmer.find("_") != std::string::npos) {
+						break;
+					}
+					cursor = kmerClassifier.startCursor(correctedKmer);
+				} else {
+					size_t end = kmerStartPos + kmerClassifier.getMinKmerSize() + inc;
+					if (corr.correctedRead.sequence[end - 2] == '_' || corr.correctedRead.sequence[end - 1] == '_') {
+						break;
+					}
+					cursor.extendRight(corr.correctedRead.sequence[end - 2]);
+					cursor.extendRight(corr.correctedRead.sequence[end - 1]);
 				}
-				type = kmerClassifier.classifyKmer(correctedKmer);
+				type = kmerClassifier.classifyKmer(cursor);
 				inc += 2;
 			}
 
@@ -598,7 +722,7 @@ bool correctKmer(const std::string &kmer, size_t kmerStartPos, CorrectedRead &co
 
 				// found the correction. Apply the correction to the corrected read.
 
-				corr.applyCorrection(bestError, i + kmerStartPos, errorProb);
+				applyProfiledCorrection(corr, profile, bestError, i + kmerStartPos, errorProb);
 				foundNewError = true;
 				return foundNewError;
 			}
@@ -611,58 +735,65 @@ bool correctKmer(const std::string &kmer, size_t kmerStartPos, CorrectedRead &co
 // TODO: Change corrRead into a const?
 bool growKmer(std::string &kmer, size_t pos, size_t &incLeft, size_t &incRight, CorrectedRead &corr,
 		KmerClassificationUnit &kmerClassifier) {
+	const std::string &sequence = corr.correctedRead.sequence;
 	size_t kMin = kmer.size();
-	size_t n = corr.correctedRead.sequence.size();
-	size_t kmerStartPos = pos;
+	size_t n = sequence.size();
 	KmerType type = KmerType::REPEAT;
 	bool res = false;
-	while (type == KmerType::REPEAT && kmerStartPos + kMin + incRight + 2 <= n) {
-		incRight += 2;
-		kmer = corr.correctedRead.sequence.substr(kmerStartPos, kMin + incRight);
-		type = kmerClassifier.classifyKmer(kmer);
+	KmerCursor cursor;
+	// while growing to the right, the k-mer starts at pos
+	if (pos + kMin + incRight + 2 <= n) {
+		cursor = kmerClassifier.startCursor(sequence.substr(pos, kMin + incRight));
+		incRight += growCursorByPairs(cursor, sequence, pos + kMin + incRight, false, (n - pos - kMin - incRight) / 2,
+				kmerClassifier, type);
 		res = true;
 	}
-	while (type == KmerType::REPEAT && pos >= incLeft + 2) {
-		incLeft += 2;
-		kmerStartPos = pos - incLeft;
-		kmer = corr.correctedRead.sequence.substr(kmerStartPos, kMin + incRight + incLeft);
-		type = kmerClassifier.classifyKmer(kmer);
+	// while growing to the left, the k-mer starts at pos - incLeft
+	if (type == KmerType::REPEAT && pos >= incLeft + 2) {
+		if (!res || incLeft > 0) {
+			cursor = kmerClassifier.startCursor(sequence.substr(pos - incLeft, kMin + incRight + incLeft));
+		}
+		incLeft += growCursorByPairs(cursor, sequence, pos - incLeft, true, (pos - incLeft) / 2, kmerClassifier, type);
 		res = true;
 	}
+	if (res) {
+		kmer = cursor.kmer();
+	}
 	return res;
 }
 
 // TODO: Change corrRead into a const?
 bool growModifiedKmer(std::string &kmer, size_t startPos, size_t &incLeft, size_t &incRight, CorrectedRead &corr,
 		KmerClassificationUnit &kmerClassifier, size_t posInKmer, ErrorType errorType) {
+	const std::string &sequence = corr.correctedRead.sequence;
 	size_t kMin = kmer.size();
-	size_t n = corr.correctedRead.sequence.size();
-	size_t kmerStartPos = startPos;
+	size_t n = sequence.size();
 	KmerType type = KmerType::REPEAT;
 
-	size_t incLeftBegin = incLeft;
-
+	// the error only touches posInKmer, so the bases added at both ends are taken unmodified from the read
 	bool res = false;
-	while (type == KmerType::REPEAT && kmerStartPos + kMin + incRight + 2 <= n) {
-		incRight += 2;
-		kmer = corr.correctedRead.sequence.substr(kmerStartPos, kMin + incRight);
-		kmer = kmerAfterError(kmer, errorType, posInKmer);
-		type = kmerClassifier.classifyKmer(kmer);
+	KmerCursor cursor;
+	if (startPos + kMin + incRight + 2 <= n) {
+		cursor = kmerClassifier.startCursor(
+				kmerAfterError(sequence.substr(startPos, kMin + incRight), errorType, posInKmer));
+		incRight += growCursorByPairs(cursor, sequence, startPos + kMin + incRight, false,
+				(n - startPos - kMin - incRight) / 2, kmerClassifier, type);
 		res = true;
 	}
 
-	/*if (startPos == 96) {
-		std::cout << "Hello breakpoint\n";
-	}*/
-
-	while (type == KmerType::REPEAT && startPos >= incLeft + 2) {
-		incLeft += 2;
-		kmerStartPos = startPos - incLeft;
-		kmer = corr.correctedRead.sequence.substr(kmerStartPos, kMin + incRight + incLeft);
-		kmer = kmerAfterError(kmer, errorType, posInKmer + incLeft - incLeftBegin);
-		type = kmerClassifier.classifyKmer(kmer);
+	if (type == KmerType::REPEAT && startPos >= incLeft + 2) {
+		if (!res || incLeft > 0) {
+			cursor = kmerClassifier.startCursor(
+					kmerAfterError(sequence.substr(startPos - incLeft, kMin + incRight + incLeft), errorType,
+							posInKmer));
+		}
+		incLeft += growCursorByPairs(cursor, sequence, startPos - incLeft, true, (startPos - incLeft) / 2,
+				kmerClassifier, type);
 		res = true;
 	}
+	if (res) {
+		kmer = cursor.kmer();
+	}
 	return res;
 }
 
@@ -672,13 +803,24 @@ CorrectedRead correctRead_KmerImproved(const FASTQRead &fastqRead, ErrorProfileU
 		KmerClassificationUnit &kmerClassifier, bool correctIndels) {
 	CorrectedRead corr(fastqRead);
 	size_t kMin = kmerClassifier.getMinKmerSize();
+	ReadKmerProfile profile(corr.correctedRead.sequence, kmerClassifier);
+	// the k-mer and the grown candidate k-mers are edited in place, their capacity fits any k-mer of the read plus the
+	// base a deletion adds, so that they are allocated once per read
+	std::string kmer;
+	std::string candidateKmer;
+	kmer.reserve(2 * corr.correctedRead.sequence.size() + 2);
+	candidateKmer.reserve(2 * corr.correctedRead.sequence.size() + 2);
 	size_t pos = 0;
 	while (pos < corr.correctedRead.sequence.size()) {
+		KmerType type = profile.classAt(pos);
+		if (type == KmerType::TRUSTED) {
+			pos++;
+			continue;
+		}
 		size_t kmerStartPos = pos;
-		std::string kmer = corr.correctedRead.sequence.substr(kmerStartPos, kMin);
+		kmer.assign(corr.correctedRead.sequence, kmerStartPos, kMin);
 		size_t incLeft = 0;
 		size_t incRight = 0;
-		KmerType type = kmerClassifier.classifyKmer(kmer);
 		if (type == KmerType::REPEAT) {
 			growKmer(kmer, pos, incLeft, incRight, corr, kmerClassifier);
 			type = kmerClassifier.classifyKmer(kmer);
@@ -690,46 +832,26 @@ CorrectedRead correctRead_KmerImproved(const FASTQRead &fastqRead, ErrorProfileU
 		while (hasFinished == false) {
 			hasFinished = true;
 			if (type == KmerType::UNTRUSTED) { // try to correct the k-mer at position incLeft in the kmer (TODO: Is this the best position to try? Or should one try all positions here?)
-				std::vector<ErrorType> reasonableTypes = reasonableErrorTypes(kmer, incLeft);
-				std::vector<ErrorType> candidates;
-				for (ErrorType errorType : reasonableTypes) {
-					std::string candidateKmer = kmerAfterError(kmer, errorType, incLeft);
-					if (kmerClassifier.classifyKmer(candidateKmer) == KmerType::REPEAT) {
-						size_t incLeftCandidate = incLeft;
-						size_t incRightCandidate = incRight;
-						growModifiedKmer(candidateKmer, kmerStartPos, incLeftCandidate, incRightCandidate, corr, kmerClassifier, incLeft, errorType);
-					}
+				// only the candidates that make the k-mer repetitive are grown and classified again
+				ErrorTypeSet repetitive;
+				ErrorTypeSet candidates = classifyCandidates(kmer, incLeft, kmerClassifier, repetitive, &profile,
+						kmerStartPos);
+				for (ErrorType errorType : repetitive) {
+					candidateKmer.assign(kmer);
+					applyErrorInPlace(candidateKmer, errorType, incLeft);
+					size_t incLeftCandidate = incLeft;
+					size_t incRightCandidate = incRight;
+					growModifiedKmer(candidateKmer, kmerStartPos, incLeftCandidate, incRightCandidate, corr, kmerClassifier, incLeft, errorType);
 					if (kmerClassifier.classifyKmer(candidateKmer) != KmerType::UNTRUSTED) {
-						candidates.push_back(errorType);
-					}
-
-					/*
-					std::string candidateKmer = kmerAfterError(kmer, errorType, incLeft);
-					KmerType candidateKmerType = kmerClassifier.classifyKmer(candidateKmer);
-					size_t incCandidate = 0;
-					// increase candidate k-mer to the right if it is repetitive
-					while (candidateKmerType == KmerType::REPEAT
-							&& kmerStartPos + incRight + incLeft + incCandidate + 2
-									<= corr.correctedRead.sequence.size()) {
-						incCandidate += 2;
-						candidateKmer = corr.correctedRead.sequence.substr(kmerStartPos,
-								kMin + incRight + incLeft + incCandidate);
-						candidateKmer = kmerAfterError(candidateKmer, errorType, incLeft);
-						candidateKmerType = kmerClassifier.classifyKmer(candidateKmer);
-					}
-					// TODO: also increase it to the left if it is still repetitive...
-					// ...
-					if (candidateKmerType != KmerType::UNTRUSTED) {
-						candidates.push_back(errorType);
+						candidates.insert(errorType);
 					}
-					*/
 				}
 
 				if (candidates.size() == 0) {
 					//std::cout << "Could not find a correction candidate for this error.\n";
 				} else if (candidates.size() == 1) {
 					//std::cout << "Clear correction candidate.\n";
-					corr.applyCorrection(candidates[0], pos, 1.0);
+					applyProfiledCorrection(corr, profile, candidates.first(), pos, 1.0);
 				} else {
 					//std::cout << "Found multiple correction candidates. k-mer size must be increased.\n";
 					//increase k-mer size and try again
@@ -747,6 +869,7 @@ CorrectedRead correctRead_KmerImproved(const FASTQRead &fastqRead, ErrorProfileU
 bool precorrectRead_KmerBased(CorrectedRead &corr, ErrorProfileUnit &errorProfile,
 		KmerClassificationUnit &kmerClassifier, bool withMultidel, bool correctIndels) {
 	// cover the read with k-mers and correct them
+	ReadKmerProfile profile(corr.correctedRead.sequence, kmerClassifier);
 	bool foundNewError = false;
 	size_t i = 0;
 	while (i < corr.correctedRead.sequence.size()) {
@@ -755,22 +878,30 @@ bool precorrectRead_KmerBased(CorrectedRead &corr, ErrorProfileUnit &errorProfil
 			i++;
 			continue;
 		}
-		KmerType kmerType = kmerClassifier.classifyKmer(kmerString);
+		KmerType kmerType = profile.classAt(i);
+		KmerCursor cursor;
+		if (kmerType == KmerType::REPEAT) {
+			cursor = kmerClassifier.startCursor(kmerString);
+		}
 
 		size_t inc = 2;
 		while (kmerType == KmerType::REPEAT
 				&& i + kmerClassifier.getMinKmerSize() + inc < corr.correctedRead.sequence.size()) {
-			kmerString = corr.correctedRead.sequence.substr(i, kmerClassifier.getMinKmerSize() + inc);
-			if (kmerString.find("_") != std::string::npos) {
+			size_t end = i + kmerClassifier.getMinKmerSize() + inc;
+			if (corr.correctedRead.sequence[end - 2] == '_' || corr.correctedRead.sequence[end - 1] == '_') {
+				kmerString = corr.correctedRead.sequence.substr(i, kmerClassifier.getMinKmerSize() + inc);
 				break;
 			}
-			kmerType = kmerClassifier.classifyKmer(kmerString);
+			cursor.extendRight(corr.correctedRead.sequence[end - 2]);
+			cursor.extendRight(corr.correctedRead.sequence[end - 1]);
+			kmerType = kmerClassifier.classifyKmer(cursor);
+			kmerString = cursor.kmer();
 			inc += 2;
 		}
 
 		if (kmerType == KmerType::UNTRUSTED) {
 			foundNewError |= correctKmer(kmerString, i, corr, errorProfile, kmerClassifier, withMultidel,
-					correctIndels);
+					correctIndels, profile);
 		}
 
 		//i += std::max(1, (int) kmerString.size() - 1);
@@ -860,6 +991,267 @@ CorrectedRead correctRead_KmerBased(const FASTQRead &fastqRead, ErrorProfileUnit
 	return corr;
 }
 
+// the bounds of the path search that repairs a stretch of a read in correctRead_DeBruijn
+static const size_t MAX_PATH_EXPANSIONS = 20000;
+static const size_t MAX_PATH_STATES = 4 * MAX_PATH_EXPANSIONS; // the search also gives up once it has queued this many
+static const size_t MAX_STATES_PER_EXPANSION = 9; // 4 substitutions or matches, 4 deletions and an insertion
+static const size_t MAX_PATH_INDELS = 3; // the most the numbers of added and replaced bases of a path may differ by
+static const double MIN_EDIT_PROBABILITY = 1e-9;
+static const double MIN_EDIT_COST = 0.01; // so that an edit never costs as little as a matching base
+static const ErrorType SUBSTITUTION_TO[4] = { ErrorType::SUB_FROM_A, ErrorType::SUB_FROM_C, ErrorType::SUB_FROM_G,
+		ErrorType::SUB_FROM_T };
+static const ErrorType DELETION_OF[4] = { ErrorType::DEL_OF_A, ErrorType::DEL_OF_C, ErrorType::DEL_OF_G,
+		ErrorType::DEL_OF_T };
+
+// A path through the graph of solid k-mers, as its last step and the state before it.
+struct PathSearchState {
+	uint64_t kmer; // the last k-mer of the path, in the direction of the search
+	size_t numReplaced; // the number of bases of the read the path replaces
+	size_t numAdded; // the number of bases the path has added to the anchor
+	size_t parent;
+	ErrorType edit; // the correction of the read the last step stands for, CORRECT if it matched the read
+	size_t editPos; // the read position of the correction, a deletion is corrected after this position
+};
+
+// The (k-mer, numReplaced, numAdded) triples a path search has expanded, in an open-addressing table that holds twice as
+// many slots as a search expands states at most. Clearing it starts a new generation instead of touching the slots.
+class ExpandedPathStates {
+public:
+	ExpandedPathStates() :
+			slots(NUM_SLOTS), generation(1) {
+	}
+	void clear() {
+		generation++;
+		if (generation == 0) { // the generations have wrapped around, so the slots have to be reset once
+			std::fill(slots.begin(), slots.end(), Slot());
+			generation = 1;
+		}
+	}
+	// false if the triple has been inserted since the last clear()
+	bool insert(uint64_t kmer, size_t numReplaced, size_t numAdded) {
+		size_t i = hashPacked(hashPacked(kmer) ^ (numReplaced << 32) ^ numAdded) & (NUM_SLOTS - 1);
+		while (slots[i].generation == generation) {
+			if (slots[i].kmer == kmer && slots[i].numReplaced == numReplaced && slots[i].numAdded == numAdded) {
+				return false;
+			}
+			i = (i + 1) & (NUM_SLOTS - 1);
+		}
+		slots[i] = {kmer, (uint32_t) numReplaced, (uint32_t) numAdded, generation};
+		return true;
+	}
+private:
+	static const size_t NUM_SLOTS = 1 << 16; // at least 2 * MAX_PATH_EXPANSIONS
+	struct Slot {
+		uint64_t kmer = 0;
+		uint32_t numReplaced = 0;
+		uint32_t numAdded = 0;
+		uint32_t generation = 0;
+	};
+	std::vector<Slot> slots;
+	uint32_t generation;
+};
+
+// The buffers of the path searches of a thread, which keep their memory from one stretch to the next.
+struct PathSearchBuffers {
+	std::vector<PathSearchState> states;
+	std::vector<std::pair<double, size_t> > queue; // a min-heap of the costs and ids of the queued states
+	ExpandedPathStates expanded;
+	std::vector<const PathSearchState*> edits;
+};
+
+// -log of how much less likely the edit is than the read being correct at the position
+static double editCost(const std::unordered_map<ErrorType, double> &probs, ErrorType edit, ErrorType noEdit) {
+	auto probEdit = probs.find(edit);
+	auto probNoEdit = probs.find(noEdit);
+	double cost = -std::log(std::max(probEdit == probs.end() ? 0.0 : probEdit->second, MIN_EDIT_PROBABILITY))
+			+ std::log(std::max(probNoEdit == probs.end() ? 0.0 : probNoEdit->second, MIN_EDIT_PROBABILITY));
+	return std::max(cost, MIN_EDIT_COST);
+}
+
+static bool withinIndelBound(size_t numAdded, size_t numReplaced) {
+	return std::max(numAdded, numReplaced) - std::min(numAdded, numReplaced) <= MAX_PATH_INDELS;
+}
+
+// Replaces numBases bases of the read, starting at position start, by the cheapest path through the graph that starts at
+// the solid anchor k-mer and, if hasTarget is set, ends at the solid target k-mer. To the right, the path appends bases
+// and replaces the bases from start on, otherwise it prepends bases and replaces the bases from start on to the left.
+// Every step either matches the next base of the read, substitutes it, skips it as an insertion, or adds a base the
+// read has lost as a deletion, and the corrections cost according to the error profile. The search is best-first and
+// gives up after MAX_PATH_EXPANSIONS expanded or MAX_PATH_STATES queued states. Returns false if the read has not been
+// changed.
+static bool repairStretch(CorrectedRead &corr, ErrorProfileUnit &errorProfile, const SolidKmerGraph &graph,
+		uint64_t anchor, size_t start, size_t numBases, bool toRight, bool hasTarget, uint64_t target,
+		bool correctIndels) {
+	const std::string &sequence = corr.correctedRead.sequence;
+	size_t k = graph.getKmerSize();
+	uint64_t mask = packedKmerMask(k);
+	size_t shift = 2 * (k - 1);
+	// the positions of the replaced bases and of the bases deletions are corrected after
+	size_t lo = toRight ? start - 1 : start + 1 - numBases;
+	size_t hi = toRight ? start + numBases - 1 : start;
+	std::vector<std::unordered_map<ErrorType, double> > probs = errorProfile.getReadErrorProbabilitiesPartial(
+			corr.correctedRead, lo, hi);
+	auto replacedPos = [&](size_t numReplaced) {
+		return toRight ? start + numReplaced : start - numReplaced;
+	};
+	// a base added before the next replaced base is a deletion after the last replaced one
+	auto deletionPosValid = [&](size_t numReplaced, size_t &pos) {
+		if (!toRight && numReplaced > start) {
+			return false;
+		}
+		pos = toRight ? start + numReplaced - 1 : start - numReplaced;
+		return pos >= lo && pos <= hi && pos + 1 < sequence.size();
+	};
+
+	static thread_local PathSearchBuffers buffers;
+	std::vector<PathSearchState> &states = buffers.states;
+	std::vector<std::pair<double, size_t> > &queue = buffers.queue;
+	std::greater<std::pair<double, size_t> > costsAbove;
+	auto enqueue = [&](double cost, const PathSearchState &state) {
+		states.push_back(state);
+		queue.push_back(std::make_pair(cost, states.size() - 1));
+		std::push_heap(queue.begin(), queue.end(), costsAbove);
+	};
+	states.clear();
+	queue.clear();
+	buffers.expanded.clear();
+	size_t numExpanded = 0;
+	enqueue(0.0, { anchor, 0, 0, 0, ErrorType::CORRECT, 0 });
+	size_t goal = 0;
+	bool found = false;
+	while (!queue.empty() && numExpanded < MAX_PATH_EXPANSIONS
+			&& states.size() + MAX_STATES_PER_EXPANSION <= MAX_PATH_STATES) {
+		double cost = queue.front().first;
+		size_t id = queue.front().second;
+		std::pop_heap(queue.begin(), queue.end(), costsAbove);
+		queue.pop_back();
+		PathSearchState state = states[id];
+		if (state.numReplaced == numBases && (!hasTarget || state.kmer == target)) {
+			goal = id;
+			found = true;
+			break;
+		}
+		if (!buffers.expanded.insert(state.kmer, state.numReplaced, state.numAdded)) {
+			continue;
+		}
+		numExpanded++;
+		size_t i = state.numReplaced;
+		uint8_t nextBases = toRight ? graph.successors(state.kmer) : graph.predecessors(state.kmer);
+		for (uint64_t code = 0; code < 4; ++code) {
+			if (!(nextBases & (1 << code))) {
+				continue;
+			}
+			uint64_t kmer = toRight ? ((state.kmer << 2) | code) & mask : (code << shift) | (state.kmer >> 2);
+			if (i < numBases && withinIndelBound(state.numAdded + 1, i + 1)) {
+				size_t pos = replacedPos(i);
+				ErrorType edit = (packBase(sequence[pos]) == code) ? ErrorType::CORRECT : SUBSTITUTION_TO[code];
+				double stepCost = (edit == ErrorType::CORRECT) ? 0 : editCost(probs[pos - lo], edit, ErrorType::CORRECT);
+				enqueue(cost + stepCost, { kmer, i + 1, state.numAdded + 1, id, edit, pos });
+			}
+			size_t pos;
+			if (correctIndels && withinIndelBound(state.numAdded + 1, i) && deletionPosValid(i, pos)) {
+				double stepCost = editCost(probs[pos - lo], DELETION_OF[code], ErrorType::NODEL);
+				enqueue(cost + stepCost, { kmer, i, state.numAdded + 1, id, DELETION_OF[code], pos });
+			}
+		}
+		if (correctIndels && i < numBases && withinIndelBound(state.numAdded, i + 1)) {
+			size_t pos = replacedPos(i);
+			double stepCost = editCost(probs[pos - lo], ErrorType::INSERTION, ErrorType::CORRECT);
+			enqueue(cost + stepCost, { state.kmer, i + 1, state.numAdded, id, ErrorType::INSERTION, pos });
+		}
+	}
+	if (!found) {
+		return false;
+	}
+
+	// The corrections are applied from the right end of the read on, so that they do not move each other. At the same
+	// position, the bases added after it go first, in the reverse order of the read.
+	std::vector<const PathSearchState*> &edits = buffers.edits;
+	edits.clear();
+	for (size_t id = goal; id != 0; id = states[id].parent) {
+		if (states[id].edit != ErrorType::CORRECT) {
+			edits.push_back(&states[id]);
+		}
+	}
+	std::sort(edits.begin(), edits.end(), [toRight](const PathSearchState *left, const PathSearchState *right) {
+		if (left->editPos != right->editPos) {
+			return left->editPos > right->editPos;
+		}
+		bool leftIsDeletion = (left->edit != ErrorType::INSERTION && !isSubstitution(left->edit));
+		bool rightIsDeletion = (right->edit != ErrorType::INSERTION && !isSubstitution(right->edit));
+		if (leftIsDeletion != rightIsDeletion) {
+			return leftIsDeletion;
+		}
+		return toRight ? left->numAdded > right->numAdded : left->numAdded < right->numAdded;
+	});
+	for (const PathSearchState *edit : edits) {
+		corr.applyCorrection(edit->edit, edit->editPos, 1.0);
+	}
+	return !edits.empty();
+}
+
+// Repairs the stretches of windows that are not solid between solid anchor windows with a path through the de Bruijn
+// graph of the solid k-mers, so that several errors close to each other are corrected at once. A stretch at an end of
+// the read is repaired from its only anchor on. Falls back to correctRead_KmerImproved if the graph is not enabled.
+CorrectedRead correctRead_DeBruijn(const FASTQRead &fastqRead, ErrorProfileUnit &errorProfile,
+		KmerClassificationUnit &kmerClassifier, bool correctIndels) {
+	const SolidKmerGraph *graph = kmerClassifier.getSolidKmerGraph();
+	if (!graph) {
+		return correctRead_KmerImproved(fastqRead, errorProfile, kmerClassifier, correctIndels);
+	}
+	CorrectedRead corr(fastqRead);
+	const std::string &sequence = corr.correctedRead.sequence;
+	size_t k = graph->getKmerSize();
+	if (sequence.size() < k) {
+		return corr;
+	}
+	size_t numWindows = sequence.size() - k + 1;
+	std::vector<uint64_t> windowKmers(numWindows);
+	std::vector<bool> solidWindow(numWindows, false);
+	uint64_t mask = packedKmerMask(k);
+	uint64_t fwd = 0;
+	size_t numValid = 0;
+	for (size_t i = 0; i < sequence.size(); ++i) {
+		uint64_t code = packBase(sequence[i]);
+		if (code > 3) {
+			numValid = 0;
+			continue;
+		}
+		fwd = ((fwd << 2) | code) & mask;
+		numValid++;
+		if (numValid >= k) {
+			windowKmers[i + 1 - k] = fwd;
+			solidWindow[i + 1 - k] = graph->isSolid(fwd);
+		}
+	}
+
+	// the stretches are repaired from right to left, so that the positions of the ones to the left stay the same
+	size_t end = numWindows;
+	while (end > 0) {
+		if (solidWindow[end - 1]) {
+			end--;
+			continue;
+		}
+		size_t begin = end - 1;
+		while (begin > 0 && !solidWindow[begin - 1]) {
+			begin--;
+		}
+		// the windows from begin to end - 1 are not solid
+		bool hasLeftAnchor = (begin > 0);
+		bool hasRightAnchor = (end < numWindows);
+		if (hasLeftAnchor) {
+			size_t start = begin - 1 + k;
+			size_t numBases = hasRightAnchor ? end + k - start : sequence.size() - start;
+			repairStretch(corr, errorProfile, *graph, windowKmers[begin - 1], start, numBases, true, hasRightAnchor,
+					hasRightAnchor ? windowKmers[end] : 0, correctIndels);
+		} else if (hasRightAnchor) {
+			repairStretch(corr, errorProfile, *graph, windowKmers[end], end - 1, end, false, false, 0, correctIndels);
+		}
+		end = begin;
+	}
+	return corr;
+}
+
 CorrectedRead correctRead_Naive(const FASTQRead &fastqRead, ErrorProfileUnit &errorProfile,
 		KmerClassificationUnit &kmerClassifier, bool correctIndels) {
 	CorrectedRead corr(fastqRead);
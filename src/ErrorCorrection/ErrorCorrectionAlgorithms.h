@@ -1,8 +1,17 @@
 
 #pragma once
 
+#include "ReadKmerProfile.h"
+
+ErrorTypeSet reasonableErrorTypes(const std::string &kmer, size_t posInKmer);
+void applyErrorInPlace(std::string &kmer, ErrorType errorType, size_t posInKmer);
+void revertErrorInPlace(std::string &kmer, ErrorType errorType, size_t posInKmer, char originalBase);
+ErrorTypeSet classifyCandidates(std::string &kmer, size_t posInKmer, KmerClassificationUnit &kmerClassifier,
+		ErrorTypeSet &repetitive, ReadKmerProfile *profile = NULL, size_t kmerStartPos = 0);
+
 CorrectedRead correctRead_KmerImproved(const FASTQRead &fastqRead, ErrorProfileUnit &errorProfile, KmerClassificationUnit &kmerClassifier, bool correctIndels = true);
 
 CorrectedRead correctRead_KmerBased(const FASTQRead &fastqRead, ErrorProfileUnit &errorProfile, KmerClassificationUnit &kmerClassifier, bool correctIndels = true);
+CorrectedRead correctRead_DeBruijn(const FASTQRead &fastqRead, ErrorProfileUnit &errorProfile, KmerClassificationUnit &kmerClassifier, bool correctIndels = true);
 CorrectedRead correctRead_Naive(const FASTQRead &fastqRead, ErrorProfileUnit &errorProfile, KmerClassificationUnit &kmerClassifier, bool correctIndels = true);
 //CorrectedRead postcorrectRead_Multidel(const FASTQRead &fastqRead, ErrorProfileUnit &errorProfile, KmerClassificationUnit &kmerClassifier);
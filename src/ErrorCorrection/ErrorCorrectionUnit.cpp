@@ -7,13 +7,16 @@
 
 #include "ErrorCorrectionUnit.h"
 
+#include <algorithm>
+#include <chrono>
 #include <functional>
 #include <iostream>
+#include <sstream>
 
 #include "../external/cereal/archives/binary.hpp"
 
-#include "../ProducerConsumerPattern.hpp"
 #include "../CorrectedRead.h"
+#include "../OrderedCorrection.hpp"
 
 ErrorCorrectionUnit::ErrorCorrectionUnit() {
 	ecEval = NULL;
@@ -25,6 +28,8 @@ ErrorCorrectionUnit::ErrorCorrectionUnit(ErrorCorrectionType type, ErrorProfileU
 		correctRead = std::bind(correctRead_KmerBased, _1, std::ref(epu), std::ref(kcu), correctIndels);
 	} else if (type == ErrorCorrectionType::KMER_IMPROVED) {
 		correctRead = std::bind(correctRead_KmerImproved, _1, std::ref(epu), std::ref(kcu), correctIndels);
+	} else if (type == ErrorCorrectionType::DE_BRUIJN) {
+		correctRead = std::bind(correctRead_DeBruijn, _1, std::ref(epu), std::ref(kcu), correctIndels);
 	} else if (type == ErrorCorrectionType::NAIVE) {
 		correctRead = std::bind(correctRead_Naive, _1, std::ref(epu), std::ref(kcu), correctIndels);
 	} else {
@@ -53,12 +58,65 @@ void ErrorCorrectionUnit::addReadsFile(const std::string &filepath, const std::s
 	//oarchive(iterators[iterators.size() - 1]->numReadsLeft());
 }
 
+void ErrorCorrectionUnit::enableReadDeduplication(ReadDeduplicationMode mode) {
+	if (mode == ReadDeduplicationMode::OFF) {
+		deduplicator.reset();
+	} else {
+		deduplicator.reset(new ReadDeduplicator(mode));
+	}
+}
+
+// Corrects the read, unless an identical read has been corrected before: then its corrections are applied again, to
+// this read's own name and quality scores. The read has to be registered with the deduplicator before.
+CorrectedRead ErrorCorrectionUnit::correctOrReuse(const FASTQRead &fastqRead) {
+	if (!deduplicator) {
+		return correctRead(fastqRead);
+	}
+	ReadKey key = deduplicator->keyOf(fastqRead);
+	std::string quality;
+	std::vector<Correction> corrections;
+	if (deduplicator->claim(key, quality, corrections)) {
+		try {
+			auto begin = std::chrono::steady_clock::now();
+			CorrectedRead cr = correctRead(quality.empty() ? fastqRead :
+					FASTQRead(fastqRead.id, fastqRead.sequence, quality));
+			deduplicator->publish(key, cr.corrections,
+					std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count());
+			if (quality.empty()) {
+				return cr;
+			}
+			corrections = cr.corrections;
+		} catch (...) {
+			deduplicator->abandon(key);
+			throw;
+		}
+	}
+	CorrectedRead cr(fastqRead);
+	for (const Correction &corr : corrections) {
+		cr.applyCorrection(corr);
+	}
+	return cr;
+}
+
+// in the order of the file, see ReadDeduplicator
+void ErrorCorrectionUnit::registerReads(const std::vector<FASTQRead> &reads) {
+	if (!deduplicator) {
+		return;
+	}
+	for (const FASTQRead &fastqRead : reads) {
+		deduplicator->registerRead(fastqRead);
+	}
+}
+
 void ErrorCorrectionUnit::correctReads() {
 	for (size_t i = 0; i < readFiles.size(); ++i) {
 		double minProgress = 0;
 		while (iterators[i]->hasReadsLeft()) {
 			FASTQRead fastqRead = iterators[i]->next();
-			CorrectedRead cr = correctRead(fastqRead);
+			if (deduplicator) {
+				deduplicator->registerRead(fastqRead);
+			}
+			CorrectedRead cr = correctOrReuse(fastqRead);
 			if (cr.correctedRead.sequence.empty()) {
 				//throw std::runtime_error("The corrected read is empty!");
 			} else {
@@ -89,63 +147,62 @@ void ErrorCorrectionUnit::correctReads() {
 		observers[j]->finalize();
 	}
 	ecEval->finalize();
+	if (deduplicator) {
+		deduplicator->printStatistics();
+	}
 }
 
-void ErrorCorrectionUnit::correctReadsMultithreaded() {
-	outMtx = std::vector<std::mutex>(readFiles.size());
-	auto fpProduce = std::bind(&ErrorCorrectionUnit::produceData, this, _1, _2);
-	auto fpConsume = std::bind(&ErrorCorrectionUnit::consumeData, this, _1, _2);
-
-	ProducerConsumerPattern<FASTQRead> pct(50, fpProduce, fpConsume);
-	pct.run(readFiles.size(), consumersPerFile * readFiles.size());
-
+// The output is the same as the one of correctReads(). Profiles that can be merged are checked by every thread into its
+// own accumulator, the other observers and the evaluation check the reads in their order, in the calling thread.
+// The error profile and the k-mer classifier the reads are corrected with must support concurrent lookups.
+void ErrorCorrectionUnit::correctReadsMultithreaded(size_t numThreads) {
+	numThreads = std::max(numThreads, (size_t) 1);
+	ObserverAccumulators accumulators(observers, numThreads);
 	for (size_t i = 0; i < readFiles.size(); ++i) {
+		correctInFileOrder<FASTQRead, CorrectedBatch>(*iterators[i], numThreads, "Read correction", 0,
+				[&](const std::vector<FASTQRead> &reads, CorrectedBatch &batch, size_t workerId) {
+					correctBatch(reads, batch, accumulators.ofThread(workerId));
+				}, [&](CorrectedBatch &batch) {
+					outFilesCorrectedReads[i] << batch.fastq;
+					for (const CorrectedRead &cr : batch.correctedReads) {
+						for (ErrorProfileUnit *observer : accumulators.getOrderedObservers()) {
+							observer->check(cr);
+						}
+						ecEval->check(cr);
+					}
+				}, [&](const std::vector<FASTQRead> &reads) {
+					registerReads(reads);
+				});
 		outFilesCorrectedReads[i].close();
 		//outFilesCorrections[i].close();
 	}
 
+	accumulators.mergeIntoObservers();
 	for (size_t j = 0; j < observers.size(); ++j) {
 		observers[j]->finalize();
 	}
-}
-
-double ErrorCorrectionUnit::produceData(std::vector<FASTQRead> &buffer, size_t producerId) {
-	if (iterators[producerId]->hasReadsLeft()) {
-		std::vector<FASTQRead> fastqReads = iterators[producerId]->next(maxBufferSize);
-		for (FASTQRead f : fastqReads) {
-			buffer.push_back(f);
-		}
+	ecEval->finalize();
+	if (deduplicator) {
+		deduplicator->printStatistics();
 	}
-
-	return iterators[producerId]->progress();
 }
 
-void ErrorCorrectionUnit::consumeData(std::vector<FASTQRead> &buffer, size_t consumerId) {
-	for (FASTQRead fastqRead : buffer) {
-		CorrectedRead cr = correctRead(fastqRead);
-
+// Corrects the reads the same way correctReads() does, and checks them into the accumulators of the calling thread.
+void ErrorCorrectionUnit::correctBatch(const std::vector<FASTQRead> &reads, CorrectedBatch &batch,
+		std::vector<std::unique_ptr<ErrorProfileUnit> > &threadAccumulators) {
+	std::stringstream ss;
+	for (const FASTQRead &fastqRead : reads) {
+		CorrectedRead cr = correctOrReuse(fastqRead);
 		if (cr.correctedRead.sequence.empty()) {
-			throw std::runtime_error("The corrected read is empty!");
+			continue;
 		}
-
-		for (size_t j = 0; j < observers.size(); ++j) {
-			observers[j]->check(cr);
+		ss << cr.correctedRead << "\n";
+		for (size_t j = 0; j < threadAccumulators.size(); ++j) {
+			threadAccumulators[j]->check(cr);
 		}
-
-		std::string correctedReadString;
-
-		std::stringstream ss;
-		ss << cr.correctedRead;
-		correctedReadString = ss.str();
-
-		std::lock_guard<std::mutex> lck(outMtx[consumerId / consumersPerFile]);
-
-		outFilesCorrectedReads[consumerId / consumersPerFile] << correctedReadString + "\n";
-		//if (cra.corrections.size() > 0) {
-		//cereal::BinaryOutputArchive oarchive(outFilesCorrections[consumerId / consumersPerFile]);
-		//oarchive(cr);
-		//}
+		batch.correctedReads.push_back(std::move(cr));
 	}
+	batch.fastq = ss.str();
 }
 
 void ErrorCorrectionUnit::addObserver(ErrorProfileUnit &epuObs) {
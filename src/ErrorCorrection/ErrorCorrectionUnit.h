@@ -11,7 +11,6 @@
 #include <fstream>
 #include <functional>
 #include <memory>
-#include <mutex>
 #include <string>
 #include <vector>
 
@@ -22,11 +21,12 @@
 #include "../FASTQModifiedIterator.h"
 #include "../KmerClassification/KmerClassificationUnit.h"
 #include "ErrorCorrectionAlgorithms.h"
+#include "ReadDeduplicator.h"
 
 using namespace std::placeholders;
 
 enum ErrorCorrectionType {
-	NAIVE = 0, KMER_BASED = 1, KMER_IMPROVED = 2
+	NAIVE = 0, KMER_BASED = 1, KMER_IMPROVED = 2, DE_BRUIJN = 3
 };
 
 /*
@@ -40,24 +40,31 @@ public:
 	void addReadsFile(const std::string &filepath);
 	void addReadsFile(const std::string &filepath, const std::string &outputPath);
 	void correctReads(); // write the results to filepath + "_precorrected.txt"
-	void correctReadsMultithreaded();
+	void correctReadsMultithreaded(size_t numThreads);
+	// identical reads are corrected once, and the others get the same corrections
+	void enableReadDeduplication(ReadDeduplicationMode mode);
 
 	void addObserver(ErrorProfileUnit& epuObs);
 private:
-	double produceData(std::vector<FASTQRead> &buffer, size_t producerId);
-	void consumeData(std::vector<FASTQRead> &buffer, size_t consumerId);
+	// consecutive reads of a file after their correction
+	struct CorrectedBatch {
+		std::string fastq; // the corrected reads, as they are written to the output file
+		std::vector<CorrectedRead> correctedReads; // the non-empty corrected reads
+	};
+	CorrectedRead correctOrReuse(const FASTQRead &fastqRead);
+	void registerReads(const std::vector<FASTQRead> &reads);
+	void correctBatch(const std::vector<FASTQRead> &reads, CorrectedBatch &batch,
+			std::vector<std::unique_ptr<ErrorProfileUnit> > &threadAccumulators);
 
 	std::vector<std::string> readFiles;
 	std::vector<std::ofstream> outFilesCorrectedReads;
 	//std::vector<std::ofstream> outFilesCorrections;
-	std::vector<std::mutex> outMtx;
 	std::vector<std::unique_ptr<FASTQModifiedIterator> > iterators;
-	size_t consumersPerFile = 3;
-	size_t maxBufferSize = consumersPerFile * 20;
 
 	std::vector<ErrorProfileUnit*> observers;
 
 	ErrorCorrectionEvaluation* ecEval;
 
 	std::function<CorrectedRead(FASTQRead)> correctRead;
+	std::unique_ptr<ReadDeduplicator> deduplicator;
 };
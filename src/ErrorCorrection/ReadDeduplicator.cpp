@@ -0,0 +1,171 @@
+/*
+ * ReadDeduplicator.cpp
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: sarah
+ */
+
+#include "ReadDeduplicator.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include "../KmerClassification/PackedKmer.h"
+
+static const size_t NUM_DEDUPLICATION_SHARDS = 64;
+static const uint64_t FIRST_SEED = 0x9e3779b97f4a7c15ULL;
+static const uint64_t SECOND_SEED = 0xc2b2ae3d27d4eb4fULL;
+
+ReadDeduplicator::ReadDeduplicator(ReadDeduplicationMode mode, size_t maxDistinctReads) :
+		shards(NUM_DEDUPLICATION_SHARDS) {
+	if (mode == ReadDeduplicationMode::OFF) {
+		throw std::runtime_error("A read deduplicator needs to know which reads are identical!");
+	}
+	this->mode = mode;
+	maxEntriesPerShard = std::max((size_t) 1, maxDistinctReads / NUM_DEDUPLICATION_SHARDS);
+	numReads = 0;
+	numDuplicates = 0;
+	numCorrected = 0;
+	numForgotten = 0;
+	waitNanoseconds = 0;
+	correctionNanoseconds = 0;
+}
+
+// Mixes the bytes of the string into the hash 8 at a time, its length keeps strings apart that end in zero bytes.
+static uint64_t hashBytes(const std::string &bytes, uint64_t hash) {
+	size_t i = 0;
+	for (; i + 8 <= bytes.size(); i += 8) {
+		uint64_t word;
+		std::memcpy(&word, bytes.data() + i, 8);
+		hash = hashPacked(hash ^ word);
+	}
+	uint64_t last = 0;
+	std::memcpy(&last, bytes.data() + i, bytes.size() - i);
+	return hashPacked(hash ^ last ^ (bytes.size() << 56));
+}
+
+ReadKey ReadDeduplicator::keyOf(const FASTQRead &read) const {
+	ReadKey key = { hashBytes(read.sequence, FIRST_SEED), hashBytes(read.sequence, SECOND_SEED) };
+	if (mode == ReadDeduplicationMode::SEQUENCE_AND_QUALITY) {
+		key.first = hashBytes(read.quality, key.first);
+		key.second = hashBytes(read.quality, key.second);
+	}
+	return key;
+}
+
+ReadDeduplicator::Shard& ReadDeduplicator::shardOf(const ReadKey &key) {
+	return shards[key.second % NUM_DEDUPLICATION_SHARDS];
+}
+
+// Only registering inserts reads, so the table is bounded here.
+void ReadDeduplicator::registerRead(const FASTQRead &read) {
+	ReadKey key = keyOf(read);
+	Shard &shard = shardOf(key);
+	std::lock_guard<std::mutex> lock(shard.mtx);
+	if (shard.entries.find(key) != shard.entries.end()) {
+		return;
+	}
+	if (shard.entries.size() >= maxEntriesPerShard) {
+		numForgotten++;
+		return;
+	}
+	Entry &entry = shard.entries[key];
+	if (mode == ReadDeduplicationMode::SEQUENCE_ONLY) {
+		entry.quality = read.quality;
+	}
+}
+
+bool ReadDeduplicator::claim(const ReadKey &key, std::string &quality, std::vector<Correction> &corrections) {
+	numReads++;
+	quality.clear();
+	Shard &shard = shardOf(key);
+	std::unique_lock<std::mutex> lock(shard.mtx);
+	auto it = shard.entries.find(key);
+	if (it == shard.entries.end()) { // the read has not been remembered
+		return true;
+	}
+	// registering may rehash the shard while this thread waits, which keeps references to the entries valid
+	Entry &entry = it->second;
+	if (entry.inProgress) { // another thread is correcting an identical read right now
+		auto begin = std::chrono::steady_clock::now();
+		shard.cvPublished.wait(lock, [&] {
+			return !entry.inProgress;
+		});
+		waitNanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(
+				std::chrono::steady_clock::now() - begin).count();
+	}
+	if (!entry.published) { // nobody has corrected it yet, or that thread has failed
+		entry.inProgress = true;
+		quality = entry.quality;
+		return true;
+	}
+	corrections = entry.corrections;
+	numDuplicates++;
+	return false;
+}
+
+void ReadDeduplicator::publish(const ReadKey &key, const std::vector<Correction> &corrections,
+		double correctionSeconds) {
+	numCorrected++;
+	correctionNanoseconds += (uint64_t) (correctionSeconds * 1e9);
+	Shard &shard = shardOf(key);
+	std::lock_guard<std::mutex> lock(shard.mtx);
+	auto it = shard.entries.find(key);
+	if (it == shard.entries.end()) { // the read has not been remembered
+		return;
+	}
+	it->second.corrections = corrections;
+	it->second.published = true;
+	it->second.inProgress = false;
+	std::string().swap(it->second.quality);
+	shard.cvPublished.notify_all();
+}
+
+void ReadDeduplicator::abandon(const ReadKey &key) {
+	Shard &shard = shardOf(key);
+	std::lock_guard<std::mutex> lock(shard.mtx);
+	auto it = shard.entries.find(key);
+	if (it != shard.entries.end() && !it->second.published) {
+		it->second.inProgress = false;
+		shard.cvPublished.notify_all();
+	}
+}
+
+size_t ReadDeduplicator::getNumReads() const {
+	return numReads;
+}
+
+size_t ReadDeduplicator::getNumDuplicates() const {
+	return numDuplicates;
+}
+
+size_t ReadDeduplicator::getNumCorrected() const {
+	return numCorrected;
+}
+
+double ReadDeduplicator::getWaitSeconds() const {
+	return waitNanoseconds / 1e9;
+}
+
+double ReadDeduplicator::getSavedSeconds() const {
+	if (numCorrected == 0) {
+		return 0;
+	}
+	return (correctionNanoseconds / 1e9) / numCorrected * numDuplicates;
+}
+
+void ReadDeduplicator::printStatistics() const {
+	double percentage = (numReads == 0) ? 0 : 100.0 * numDuplicates / numReads;
+	std::cout << "Read deduplication: " << numDuplicates << " of " << numReads << " reads (" << percentage
+			<< " %) reused the corrections of an identical read, " << numCorrected << " reads were corrected.\n";
+	std::cout << "Read deduplication saved about " << getSavedSeconds() << " s of correction time and waited "
+			<< getWaitSeconds() << " s for identical reads in progress";
+	if (numForgotten > 0) {
+		std::cout << ", " << numForgotten << " reads were not remembered as the table was full";
+	}
+	std::cout << ".\n";
+}
@@ -0,0 +1,94 @@
+/*
+ * ReadDeduplicator.h
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: sarah
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../Correction.h"
+#include "../FASTQRead.h"
+
+/*
+ * Which reads count as identical: reads with the same sequence and the same quality scores are corrected the same way.
+ * Reads that only share their sequence are corrected like the first of them in the order of the file, which is only an
+ * approximation if the error profile looks at the quality scores.
+ */
+enum class ReadDeduplicationMode {
+	OFF = 0, SEQUENCE_AND_QUALITY = 1, SEQUENCE_ONLY = 2
+};
+
+// a 128-bit hash of what makes reads identical, two different reads share it with negligible probability
+struct ReadKey {
+	uint64_t first;
+	uint64_t second;
+	bool operator==(const ReadKey &other) const {
+		return first == other.first && second == other.second;
+	}
+};
+
+/*
+ * Remembers the corrections of every distinct read, so that the reads identical to it are not corrected again.
+ * The reads are registered in the order of the file, which decides the remembered reads and, if only the sequences
+ * have to match, the quality scores they are corrected with: the ones of the first read with that sequence. So the
+ * corrections do not depend on the order the threads claim the reads in.
+ * The first thread that claims a remembered read corrects it and publishes its corrections, other threads that claim
+ * an identical read in the meantime wait for them. The reads are spread over independently locked shards, and at most
+ * maxDistinctReads of them are remembered: further distinct reads are corrected as if deduplication was off.
+ */
+class ReadDeduplicator {
+public:
+	ReadDeduplicator(ReadDeduplicationMode mode, size_t maxDistinctReads = 1 << 24);
+	ReadKey keyOf(const FASTQRead &read) const;
+	// has to be called for every read in the order of the file, before the read is claimed
+	void registerRead(const FASTQRead &read);
+	// True if the caller has to correct the read and publish or abandon it, with the given quality scores if they are
+	// not empty. Otherwise the corrections are the ones of an identical read.
+	bool claim(const ReadKey &key, std::string &quality, std::vector<Correction> &corrections);
+	void publish(const ReadKey &key, const std::vector<Correction> &corrections, double correctionSeconds);
+	void abandon(const ReadKey &key); // the claimed read could not be corrected, another thread may try again
+	size_t getNumReads() const;
+	size_t getNumDuplicates() const;
+	size_t getNumCorrected() const;
+	double getWaitSeconds() const;
+	double getSavedSeconds() const; // estimated from the average time a correction took
+	void printStatistics() const;
+private:
+	struct ReadKeyHash {
+		size_t operator()(const ReadKey &key) const {
+			return key.first;
+		}
+	};
+	struct Entry {
+		bool inProgress = false; // a thread is correcting the read
+		bool published = false;
+		std::string quality; // of the first read in the file, only needed until published if only sequences match
+		std::vector<Correction> corrections;
+	};
+	struct Shard {
+		std::mutex mtx;
+		std::condition_variable cvPublished;
+		std::unordered_map<ReadKey, Entry, ReadKeyHash> entries;
+	};
+	Shard& shardOf(const ReadKey &key);
+
+	ReadDeduplicationMode mode;
+	size_t maxEntriesPerShard;
+	std::vector<Shard> shards;
+	std::atomic<size_t> numReads;
+	std::atomic<size_t> numDuplicates;
+	std::atomic<size_t> numCorrected;
+	std::atomic<size_t> numForgotten; // registered reads that were not remembered
+	std::atomic<uint64_t> waitNanoseconds;
+	std::atomic<uint64_t> correctionNanoseconds;
+};
@@ -0,0 +1,162 @@
+/*
+ * ReadKmerProfile.cpp
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: sarah
+ */
+
+#include "ReadKmerProfile.h"
+
+#include <algorithm>
+
+#include "../KmerClassification/PackedKmer.h"
+
+ReadKmerProfile::ReadKmerProfile(const std::string &readSequence, KmerClassificationUnit &classifier) :
+		sequence(readSequence), kmerClassifier(classifier), windows(readSequence.size()) {
+	k = kmerClassifier.getMinKmerSize();
+	if (k <= MAX_PACKED_KMER_SIZE) {
+		neighbourTypes.resize(windows.size() * 4 * k);
+		batchKmers.reserve(windows.size());
+		batchIndices.reserve(windows.size());
+		batchTypes.reserve(windows.size());
+	}
+}
+
+size_t ReadKmerProfile::getKmerSize() const {
+	return k;
+}
+
+KmerType ReadKmerProfile::classAt(size_t pos) {
+	Window &window = windows[pos];
+	if (!window.known) {
+		profileWindowsFrom(pos);
+		if (!window.known) {
+			window.type = kmerClassifier.classifyKmer(sequence.substr(pos, k));
+			window.known = true;
+		}
+	}
+	return window.type;
+}
+
+bool ReadKmerProfile::substitutionClass(size_t pos, size_t offset, char base, KmerType &type) {
+	size_t index;
+	if (!findNeighbour(pos, offset, base, index)) {
+		return false;
+	}
+	type = neighbourTypes[index];
+	return true;
+}
+
+// The windows behind the change keep their profile and move along.
+void ReadKmerProfile::baseReplaced(size_t pos, size_t numNewBases) {
+	size_t neighboursPerWindow = 4 * k;
+	if (numNewBases == 0) {
+		windows.erase(windows.begin() + pos);
+		if (!neighbourTypes.empty()) {
+			neighbourTypes.erase(neighbourTypes.begin() + pos * neighboursPerWindow,
+					neighbourTypes.begin() + (pos + 1) * neighboursPerWindow);
+		}
+	} else if (numNewBases > 1) {
+		windows.insert(windows.begin() + pos, numNewBases - 1, Window());
+		if (!neighbourTypes.empty()) {
+			neighbourTypes.insert(neighbourTypes.begin() + pos * neighboursPerWindow,
+					(numNewBases - 1) * neighboursPerWindow, KmerType::UNTRUSTED);
+		}
+	}
+	size_t from = (pos + 1 >= k) ? pos + 1 - k : 0;
+	size_t to = std::min(pos + std::max(numNewBases, (size_t) 1), windows.size());
+	for (size_t i = from; i < to; ++i) {
+		windows[i] = Window();
+	}
+}
+
+// Profiles the windows from pos on that are not known yet in one batch.
+void ReadKmerProfile::profileWindowsFrom(size_t pos) {
+	if (k > MAX_PACKED_KMER_SIZE) {
+		return;
+	}
+	uint64_t mask = packedKmerMask(k);
+	size_t shift = 2 * (k - 1);
+	uint64_t fwd = 0;
+	uint64_t rc = 0;
+	size_t numValid = 0;
+	batchKmers.clear();
+	batchIndices.clear();
+	for (size_t i = pos; i < sequence.size(); ++i) {
+		uint64_t code = packBase(sequence[i]);
+		if (code > 3) {
+			numValid = 0;
+			continue;
+		}
+		fwd = ((fwd << 2) | code) & mask;
+		rc = (rc >> 2) | ((3 - code) << shift);
+		numValid++;
+		if (numValid >= k && !windows[i + 1 - k].known) {
+			Window &window = windows[i + 1 - k];
+			window.fwd = fwd;
+			window.rc = rc;
+			// a k-mer and its reverse complement have the same class
+			batchKmers.push_back(std::min(fwd, rc));
+			batchIndices.push_back(i + 1 - k);
+		}
+	}
+	if (batchKmers.empty()) {
+		return;
+	}
+	kmerClassifier.classifyKmers(batchKmers, k, batchTypes);
+	for (size_t j = 0; j < batchIndices.size(); ++j) {
+		Window &window = windows[batchIndices[j]];
+		window.type = batchTypes[j];
+		window.known = true;
+		window.profiled = true;
+	}
+}
+
+// Classifies the three k-mers that replace the base at offset in the window at pos. Replacing the base at an offset
+// changes the same two bits of every k-mer with that base, so a neighbour costs a few bit operations.
+void ReadKmerProfile::profileNeighbours(size_t pos, size_t offset) {
+	Window &window = windows[pos];
+	size_t fwdShift = 2 * (k - 1 - offset);
+	uint64_t oldCode = (window.fwd >> fwdShift) & 3;
+	batchKmers.clear();
+	batchIndices.clear();
+	for (uint64_t code = 0; code < 4; ++code) {
+		size_t index = neighbourIndex(pos, offset, code);
+		if (code == oldCode) {
+			neighbourTypes[index] = window.type;
+			continue;
+		}
+		uint64_t diff = oldCode ^ code; // the complements of the two bases differ in the same bits
+		uint64_t fwd = window.fwd ^ (diff << fwdShift);
+		uint64_t rc = window.rc ^ (diff << (2 * offset));
+		batchKmers.push_back(std::min(fwd, rc));
+		batchIndices.push_back(index);
+	}
+	kmerClassifier.classifyKmers(batchKmers, k, batchTypes);
+	for (size_t j = 0; j < batchIndices.size(); ++j) {
+		neighbourTypes[batchIndices[j]] = batchTypes[j];
+	}
+	window.profiledOffsets |= (uint32_t) 1 << offset;
+}
+
+bool ReadKmerProfile::findNeighbour(size_t pos, size_t offset, char base, size_t &index) {
+	uint64_t code = packBase(base);
+	if (offset >= k || code > 3) {
+		return false;
+	}
+	if (!windows[pos].known) {
+		profileWindowsFrom(pos);
+	}
+	if (!windows[pos].profiled) {
+		return false;
+	}
+	if (!(windows[pos].profiledOffsets & ((uint32_t) 1 << offset))) {
+		profileNeighbours(pos, offset);
+	}
+	index = neighbourIndex(pos, offset, code);
+	return true;
+}
+
+size_t ReadKmerProfile::neighbourIndex(size_t pos, size_t offset, uint64_t code) const {
+	return (pos * k + offset) * 4 + code;
+}
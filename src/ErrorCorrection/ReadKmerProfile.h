@@ -0,0 +1,62 @@
+/*
+ * ReadKmerProfile.h
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: sarah
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../KmerClassification/KmerClassificationUnit.h"
+#include "../KmerClassification/KmerType.h"
+
+/*
+ * The classes of the windows of one read, i.e. of its k-mers of the minimum size by their start position, and of the
+ * k-mers one substitution away from them, which the correction algorithms read instead of classifying the same k-mers
+ * again and again.
+ * The windows are encoded as a rolling 2-bit k-mer and its reverse complement, and their canonical k-mers are
+ * classified in one batch, which only counts the k-mers the class tables do not know. The substitution neighbours of a
+ * window are classified by offset once the correction asks for one of them, as it tries a single offset per window.
+ * The profile follows the read through baseReplaced(), which only invalidates the windows overlapping the change.
+ * Windows with other bases than A, C, G and T, the shorter windows at the end of the read and windows of more than
+ * 31 bases are not profiled, classAt() classifies them one at a time.
+ */
+class ReadKmerProfile {
+public:
+	ReadKmerProfile(const std::string &readSequence, KmerClassificationUnit &classifier);
+	size_t getKmerSize() const;
+	KmerType classAt(size_t pos); // the class of sequence.substr(pos, k)
+	// the class of the window at pos with the base at pos + offset replaced by base, false if not profiled
+	bool substitutionClass(size_t pos, size_t offset, char base, KmerType &type);
+	// has to be called after the base at pos of the read has been replaced by numNewBases bases
+	void baseReplaced(size_t pos, size_t numNewBases);
+private:
+	struct Window {
+		uint64_t fwd = 0;
+		uint64_t rc = 0;
+		KmerType type = KmerType::UNTRUSTED;
+		bool known = false; // the type is valid
+		bool profiled = false; // fwd and rc are valid as well
+		uint32_t profiledOffsets = 0; // bit o is set once the neighbours with a replaced base at offset o are known
+	};
+	void profileWindowsFrom(size_t pos);
+	void profileNeighbours(size_t pos, size_t offset);
+	bool findNeighbour(size_t pos, size_t offset, char base, size_t &index);
+	size_t neighbourIndex(size_t pos, size_t offset, uint64_t code) const;
+
+	const std::string &sequence;
+	KmerClassificationUnit &kmerClassifier;
+	size_t k;
+	std::vector<Window> windows;
+	// 4 entries for every base of every window, one for each base it may be replaced by
+	std::vector<KmerType> neighbourTypes;
+	// the batches to classify, reserved for all windows up front so that profiling known k-mers allocates no memory
+	std::vector<uint64_t> batchKmers;
+	std::vector<size_t> batchIndices;
+	std::vector<KmerType> batchTypes;
+};
@@ -10,6 +10,7 @@
 #include <stddef.h>
 #include <cassert>
 #include <fstream>
+#include <memory>
 #include <stdexcept>
 #include <string>
 #include <unordered_map>
@@ -114,6 +115,16 @@ public:
 	virtual void check(const CorrectedRead &corrRead, double acceptProb = 1.0) = 0;
 	virtual void checkAligned(const CorrectedReadAligned &corrRead, double acceptProb = 1.0) = 0;
 	virtual void finalize() = 0;
+
+	// Reads that are corrected in parallel are checked by every thread into an empty profile of the same kind, which
+	// is merged into this one before finalize(). Profiles that cannot be merged return NULL, and the reads are checked
+	// by them in their order instead.
+	virtual std::unique_ptr<ErrorProfileUnit> createAccumulator() {
+		return NULL;
+	}
+	virtual void mergeAccumulator(const ErrorProfileUnit &accumulator) {
+		throw std::runtime_error("This error profile cannot merge accumulators!");
+	}
 protected:
 	virtual std::unordered_map<ErrorType, double> getErrorProbabilitiesFinalized(const FASTQRead &read, size_t positionInRead) = 0;
 	virtual std::unordered_map<ErrorType, double> getErrorProbabilitiesFinalized(const std::string &kmer, size_t positionInKmer) = 0;
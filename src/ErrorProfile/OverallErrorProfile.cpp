@@ -250,6 +250,25 @@ void OverallErrorProfile::reset() {
 	}
 }
 
+std::unique_ptr<ErrorProfileUnit> OverallErrorProfile::createAccumulator() {
+	return std::unique_ptr<ErrorProfileUnit>(new OverallErrorProfile());
+}
+
+// All statistics are counts, so they are simply added.
+void OverallErrorProfile::mergeAccumulator(const ErrorProfileUnit &accumulator) {
+	const OverallErrorProfile &other = dynamic_cast<const OverallErrorProfile&>(accumulator);
+	finalized = false;
+	totalCount += other.totalCount;
+	noncorrectBases += other.noncorrectBases;
+	deletedBases += other.deletedBases;
+	for (auto kv : other.counts) {
+		counts[kv.first] += kv.second;
+	}
+	for (auto kv : other.substitutionMatrix) {
+		substitutionMatrix[kv.first] += kv.second;
+	}
+}
+
 void OverallErrorProfile::finalize() {
 	if (finalized) {
 		return;
@@ -308,6 +327,11 @@ void OverallErrorProfile::finalize() {
 					(double) substitutionMatrix[std::make_pair('T', invalidBase)] / totalCount);
 		}
 	}
+	// the entries of a base replaced by itself are 0, as they were when a lookup inserted them, and exist in advance so
+	// that reads can be corrected concurrently
+	for (size_t i = 0; i < 4; ++i) {
+		substitutionMatrix_finalized[std::make_pair(bases[i], bases[i])] = 0;
+	}
 
 	assert(noncorrectBases <= totalCount);
 	counts_finalized[ErrorType::CORRECT] = log((double) (totalCount - noncorrectBases) / totalCount);
@@ -34,6 +34,8 @@ public:
 	virtual void checkAligned(const CorrectedReadAligned &corrRead, double acceptProb = 1.0);
 
 	virtual void finalize();
+	virtual std::unique_ptr<ErrorProfileUnit> createAccumulator();
+	virtual void mergeAccumulator(const ErrorProfileUnit &accumulator);
 
 	double getOverallErrorRateCurrentBase();
 	double getOverallErrorRateNextGap();
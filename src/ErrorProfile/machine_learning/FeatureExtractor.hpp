@@ -61,7 +61,6 @@ public:
 		return classes;
 	}
 protected:
-	// TODO: Make this way faster! Maybe by using some kind of binary search?
 	double kmerZScoreExtract(const std::string &sequence, size_t posInRead, const std::string &middleAs,
 			bool leftPossibleOrig, bool rightPossibleOrig) {
 		bool leftPossible = leftPossibleOrig;
@@ -115,7 +114,12 @@ protected:
 		// trying to speed up things: end
 		*/
 
-		while ((leftPossible || rightPossible) && kmer.size() < maxKmerSize) {
+		// the k-mer grows to the left as far as possible and then to the right, and is classified at every odd size
+		// until it contains a gap
+		std::vector<KmerExtension> extensions;
+		std::vector<size_t> checkpoints;
+		bool gapReached = false;
+		while ((leftPossible || rightPossible) && middleAs.size() + extensions.size() < maxKmerSize) {
 			if (goLeft) {
 				if (offsetLeft > posInRead) {
 					leftPossible = false;
@@ -123,13 +127,11 @@ protected:
 						goLeft = false;
 					}
 				} else {
-					kmer = sequence[posInRead - offsetLeft] + kmer;
-					if (kmer.size() >= minKmerSize && kmer.size() % 2 == 1) {
-						if (kmerClassifier.classifyKmer(kmer) != KmerType::REPEAT) {
-							zScore = kmerClassifier.kmerZScore(kmer);
-							//lastKmerSize = kmer.size();
-							break;
-						}
+					extensions.push_back( { sequence[posInRead - offsetLeft], true });
+					gapReached = gapReached || extensions.back().base == '_';
+					if (!gapReached && middleAs.size() + extensions.size() >= minKmerSize
+							&& (middleAs.size() + extensions.size()) % 2 == 1) {
+						checkpoints.push_back(extensions.size());
 					}
 					offsetLeft++;
 				}
@@ -140,18 +142,23 @@ protected:
 						goLeft = true;
 					}
 				} else {
-					kmer =  kmer + sequence[posInRead + offsetRight];
-					if (kmer.size() >= minKmerSize && kmer.size() % 2 == 1) {
-						if (kmerClassifier.classifyKmer(kmer) != KmerType::REPEAT) {
-							zScore = kmerClassifier.kmerZScore(kmer);
-							//lastKmerSize = kmer.size();
-							break;
-						}
+					extensions.push_back( { sequence[posInRead + offsetRight], false });
+					gapReached = gapReached || extensions.back().base == '_';
+					if (!gapReached && middleAs.size() + extensions.size() >= minKmerSize
+							&& (middleAs.size() + extensions.size()) % 2 == 1) {
+						checkpoints.push_back(extensions.size());
 					}
 					offsetRight++;
 				}
 			}
 		}
+
+		KmerCursor cursor = kmerClassifier.startCursor(middleAs);
+		size_t numExtended;
+		if (kmerClassifier.classifyGrowingKmer(cursor, extensions, checkpoints, numExtended) != KmerType::REPEAT) {
+			zScore = kmerClassifier.kmerZScore(cursor);
+			//lastKmerSize = kmer.size();
+		}
 		return zScore;
 	}
 
@@ -7,6 +7,7 @@
 
 #pragma once
 
+#include <stdint.h>
 #include <type_traits>
 #include <iostream>
 
@@ -61,6 +62,66 @@ inline unsigned errorTypeToNumber(const ErrorType &type) {
 	return (unsigned) type;
 }
 
+/*
+ * A set of error types as a bitmask with one bit per error type, so it needs no heap memory. Iterating over it yields the
+ * error types in the order of their numbers.
+ */
+class ErrorTypeSet {
+public:
+	class const_iterator {
+	public:
+		const_iterator(uint16_t remainingBits) :
+				bits(remainingBits) {
+		}
+		ErrorType operator*() const {
+			return static_cast<ErrorType>(__builtin_ctz(bits));
+		}
+		const_iterator& operator++() {
+			bits &= bits - 1;
+			return *this;
+		}
+		bool operator!=(const const_iterator &other) const {
+			return bits != other.bits;
+		}
+	private:
+		uint16_t bits;
+	};
+
+	ErrorTypeSet() :
+			bits(0) {
+	}
+	void insert(ErrorType type) {
+		bits |= bitOf(type);
+	}
+	void erase(ErrorType type) {
+		bits &= ~bitOf(type);
+	}
+	bool contains(ErrorType type) const {
+		return (bits & bitOf(type)) != 0;
+	}
+	bool empty() const {
+		return bits == 0;
+	}
+	size_t size() const {
+		return __builtin_popcount(bits);
+	}
+	ErrorType first() const { // must not be empty
+		return static_cast<ErrorType>(__builtin_ctz(bits));
+	}
+	const_iterator begin() const {
+		return const_iterator(bits);
+	}
+	const_iterator end() const {
+		return const_iterator(0);
+	}
+private:
+	static uint16_t bitOf(ErrorType type) {
+		return (uint16_t) (1u << errorTypeToNumber(type));
+	}
+
+	uint16_t bits;
+};
+
 inline ErrorType errorTypeFromString(const std::string &typeString) {
 	if (typeString == "CORRECT") {
 		return ErrorType::CORRECT;
@@ -0,0 +1,430 @@
+/*
+ * FMIndexVariants.h
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: sarah
+ */
+
+#pragma once
+
+#include <sdsl/csa_wt.hpp>
+#include <sdsl/int_vector.hpp>
+#include <sdsl/rank_support_v.hpp>
+#include <sdsl/rank_support_v5.hpp>
+#include <sdsl/rrr_vector.hpp>
+#include <sdsl/select_support_mcl.hpp>
+#include <sdsl/select_support_scan.hpp>
+#include <sdsl/suffix_arrays.hpp>
+#include <sdsl/wm_int.hpp>
+#include <sdsl/wt_huff.hpp>
+#include <sdsl/wt_int.hpp>
+#include <stddef.h>
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+/*
+ * The FM index variants a KmerCounter can be built on. They differ in the wavelet tree over the BWT and in the
+ * rank and select support of its bit vectors, and all of them return the same counts.
+ * HUFF_COMPACT is the original index: Huffman-shaped wavelet tree, rank_support_v5 and scan-based select.
+ * HUFF_COMPRESSED stores the bit vectors of the Huffman-shaped tree as RRR vectors, so the BWT is compressed.
+ * HUFF_FAST, INT_FAST and MATRIX_FAST use uncompressed bit vectors with the faster rank_support_v and a
+ * Huffman-shaped wavelet tree, a balanced wavelet tree and a wavelet matrix, respectively.
+ */
+enum class FMIndexType {
+	HUFF_COMPACT = 0, HUFF_COMPRESSED = 1, HUFF_FAST = 2, INT_FAST = 3, MATRIX_FAST = 4
+};
+
+static const std::vector<FMIndexType> ALL_FM_INDEX_TYPES = { FMIndexType::HUFF_COMPACT, FMIndexType::HUFF_COMPRESSED,
+		FMIndexType::HUFF_FAST, FMIndexType::INT_FAST, FMIndexType::MATRIX_FAST };
+
+inline std::string fmIndexTypeToString(FMIndexType type) {
+	switch (type) {
+	case FMIndexType::HUFF_COMPACT:
+		return "huff_compact";
+	case FMIndexType::HUFF_COMPRESSED:
+		return "huff_compressed";
+	case FMIndexType::HUFF_FAST:
+		return "huff_fast";
+	case FMIndexType::INT_FAST:
+		return "int_fast";
+	case FMIndexType::MATRIX_FAST:
+		return "matrix_fast";
+	default:
+		throw std::runtime_error("Unknown FM index type!");
+	}
+}
+
+// The original index keeps its file name, the other variants are stored next to it.
+inline std::string fmIndexFileSuffix(FMIndexType type) {
+	if (type == FMIndexType::HUFF_COMPACT) {
+		return ".fm9";
+	}
+	return "." + fmIndexTypeToString(type) + ".fm9";
+}
+
+/*
+ * The operations KmerCounter needs from its FM index. A backward search step costs one virtual call on top of its
+ * rank queries, which is small compared to the cache misses of the queries.
+ */
+class FMIndexInterface {
+public:
+	virtual ~FMIndexInterface() {
+	}
+	virtual size_t size() const = 0;
+	virtual size_t sigma() const = 0;
+	virtual char symbol(size_t comp) const = 0;
+	// one backward search step on the half-open interval [begin, end), which must not be empty
+	virtual void extendInterval(size_t &begin, size_t &end, char base) const = 0;
+	// one backward search step on each of the count non-empty intervals [begin[i], end[i]), with the same results as
+	// count calls of extendInterval
+	virtual void extendIntervals(size_t *begin, size_t *end, const char *bases, size_t count) const = 0;
+	virtual void load(std::istream &in) = 0;
+	virtual void serialize(std::ostream &out) const = 0;
+	virtual void construct(sdsl::cache_config &config) = 0;
+	virtual double sizeInMegaBytes() const = 0;
+};
+
+/*
+ * The wavelet trees and matrices over uncompressed bit vectors, with their rank walk split into single levels. A
+ * backward search step is two rank queries on the wavelet tree, and every level of a rank query reads the bit vector
+ * at a position that depends on the level above, so its cache misses cannot be overlapped within one search. Walking
+ * the queries of several searches level by level instead, and prefetching the words of the next level as soon as a
+ * level is done, overlaps the misses of the independent searches on every level. Only the bit vector words are
+ * prefetched, the blocks of the rank support are private to sdsl.
+ * These classes add no members, so their indexes are stored exactly like the sdsl wavelet trees they derive from.
+ */
+template<class t_rank, class t_select, class t_select_zero>
+class WalkableWtHuff: public sdsl::wt_huff<sdsl::bit_vector, t_rank, t_select, t_select_zero> {
+	typedef sdsl::wt_huff<sdsl::bit_vector, t_rank, t_select, t_select_zero> wt_type;
+public:
+	using wt_type::wt_type;
+
+	// the ranks of a symbol before the positions begin and end, in the node the walk has reached
+	struct RankWalk {
+		typename wt_type::node_type node;
+		uint64_t path;
+		uint32_t levelsLeft;
+		size_t begin;
+		size_t end;
+	};
+
+	void startRankWalk(RankWalk &walk, uint64_t symbol, size_t begin, size_t end) const {
+		walk.begin = begin;
+		walk.end = end;
+		walk.levelsLeft = 0;
+		if (!this->m_tree.is_valid(this->m_tree.c_to_leaf(symbol))) {
+			walk.begin = walk.end = 0;
+			return;
+		}
+		walk.path = this->m_tree.bit_path(symbol);
+		walk.levelsLeft = walk.path >> 56;
+		walk.node = this->m_tree.root();
+		if (walk.levelsLeft > 0) {
+			prefetchLevel(walk);
+		}
+	}
+
+	// returns whether the walk has levels left
+	bool stepRankWalk(RankWalk &walk) const {
+		if (walk.levelsLeft == 0 || walk.end == 0) {
+			return false;
+		}
+		size_t nodeBegin = this->m_tree.bv_pos(walk.node);
+		size_t onesBeforeNode = this->m_tree.bv_pos_rank(walk.node);
+		size_t onesBeforeBegin = this->m_bv_rank(nodeBegin + walk.begin) - onesBeforeNode;
+		size_t onesBeforeEnd = this->m_bv_rank(nodeBegin + walk.end) - onesBeforeNode;
+		if (walk.path & 1) {
+			walk.begin = onesBeforeBegin;
+			walk.end = onesBeforeEnd;
+		} else {
+			walk.begin -= onesBeforeBegin;
+			walk.end -= onesBeforeEnd;
+		}
+		walk.node = this->m_tree.child(walk.node, walk.path & 1);
+		walk.path >>= 1;
+		walk.levelsLeft--;
+		if (walk.levelsLeft == 0 || walk.end == 0) {
+			return false;
+		}
+		prefetchLevel(walk);
+		return true;
+	}
+private:
+	void prefetchLevel(const RankWalk &walk) const {
+		const uint64_t *words = this->m_bv.data() + (this->m_tree.bv_pos(walk.node) >> 6);
+		__builtin_prefetch(words + (walk.begin >> 6));
+		__builtin_prefetch(words + (walk.end >> 6));
+	}
+};
+
+// The levels of a balanced wavelet tree are stored one after the other, each with the zeros child of a node in front
+// of its ones child.
+template<class t_rank, class t_select, class t_select_zero>
+class WalkableWtInt: public sdsl::wt_int<sdsl::bit_vector, t_rank, t_select, t_select_zero> {
+	typedef sdsl::wt_int<sdsl::bit_vector, t_rank, t_select, t_select_zero> wt_type;
+public:
+	using wt_type::wt_type;
+
+	struct RankWalk {
+		uint64_t symbol;
+		uint64_t mask;
+		size_t nodeBegin;
+		size_t nodeSize;
+		size_t begin;
+		size_t end;
+	};
+
+	void startRankWalk(RankWalk &walk, uint64_t symbol, size_t begin, size_t end) const {
+		walk.symbol = symbol;
+		walk.begin = begin;
+		walk.end = end;
+		walk.mask = 0;
+		if (this->m_max_level == 0 || symbol >= (1ULL << this->m_max_level)) {
+			walk.begin = walk.end = 0;
+			return;
+		}
+		walk.mask = 1ULL << (this->m_max_level - 1);
+		walk.nodeBegin = 0;
+		walk.nodeSize = this->m_size;
+		prefetchLevel(walk);
+	}
+
+	bool stepRankWalk(RankWalk &walk) const {
+		if (walk.mask == 0 || walk.end == 0) {
+			return false;
+		}
+		size_t onesBeforeNode = this->m_tree_rank(walk.nodeBegin);
+		size_t onesBeforeBegin = this->m_tree_rank(walk.nodeBegin + walk.begin) - onesBeforeNode;
+		size_t onesBeforeEnd = this->m_tree_rank(walk.nodeBegin + walk.end) - onesBeforeNode;
+		size_t onesInNode = this->m_tree_rank(walk.nodeBegin + walk.nodeSize) - onesBeforeNode;
+		if (walk.symbol & walk.mask) {
+			walk.nodeBegin += this->m_size + walk.nodeSize - onesInNode;
+			walk.nodeSize = onesInNode;
+			walk.begin = onesBeforeBegin;
+			walk.end = onesBeforeEnd;
+		} else {
+			walk.nodeBegin += this->m_size;
+			walk.nodeSize -= onesInNode;
+			walk.begin -= onesBeforeBegin;
+			walk.end -= onesBeforeEnd;
+		}
+		walk.mask >>= 1;
+		if (walk.mask == 0 || walk.end == 0) {
+			return false;
+		}
+		prefetchLevel(walk);
+		return true;
+	}
+private:
+	void prefetchLevel(const RankWalk &walk) const {
+		const uint64_t *words = this->m_tree.data();
+		__builtin_prefetch(words + (walk.nodeBegin >> 6));
+		__builtin_prefetch(words + ((walk.nodeBegin + walk.begin) >> 6));
+		__builtin_prefetch(words + ((walk.nodeBegin + walk.end) >> 6));
+		__builtin_prefetch(words + ((walk.nodeBegin + walk.nodeSize) >> 6));
+	}
+};
+
+// The levels of a wavelet matrix are stored one after the other, each with all zeros in front of all ones.
+template<class t_rank, class t_select, class t_select_zero>
+class WalkableWmInt: public sdsl::wm_int<sdsl::bit_vector, t_rank, t_select, t_select_zero> {
+	typedef sdsl::wm_int<sdsl::bit_vector, t_rank, t_select, t_select_zero> wt_type;
+public:
+	using wt_type::wt_type;
+
+	struct RankWalk {
+		uint64_t symbol;
+		uint32_t level;
+		size_t nodeBegin;
+		size_t begin;
+		size_t end;
+	};
+
+	void startRankWalk(RankWalk &walk, uint64_t symbol, size_t begin, size_t end) const {
+		walk.symbol = symbol;
+		walk.begin = begin;
+		walk.end = end;
+		walk.level = this->m_max_level;
+		if (this->m_max_level == 0 || symbol >= (1ULL << this->m_max_level)) {
+			walk.begin = walk.end = 0;
+			return;
+		}
+		walk.level = 0;
+		walk.nodeBegin = 0;
+		prefetchLevel(walk);
+	}
+
+	bool stepRankWalk(RankWalk &walk) const {
+		if (walk.level == this->m_max_level || walk.end == 0) {
+			return false;
+		}
+		size_t levelBegin = walk.level * this->m_size;
+		size_t onesBeforeNode = this->m_tree_rank(walk.nodeBegin);
+		size_t onesBeforeBegin = this->m_tree_rank(walk.nodeBegin + walk.begin) - onesBeforeNode;
+		size_t onesBeforeEnd = this->m_tree_rank(walk.nodeBegin + walk.end) - onesBeforeNode;
+		size_t onesOfLevelBeforeNode = onesBeforeNode - this->m_rank_level[walk.level];
+		if ((walk.symbol >> (this->m_max_level - 1 - walk.level)) & 1) {
+			walk.nodeBegin = levelBegin + this->m_size + this->m_zero_cnt[walk.level] + onesOfLevelBeforeNode;
+			walk.begin = onesBeforeBegin;
+			walk.end = onesBeforeEnd;
+		} else {
+			walk.nodeBegin = levelBegin + this->m_size + (walk.nodeBegin - levelBegin) - onesOfLevelBeforeNode;
+			walk.begin -= onesBeforeBegin;
+			walk.end -= onesBeforeEnd;
+		}
+		walk.level++;
+		if (walk.level == this->m_max_level || walk.end == 0) {
+			return false;
+		}
+		prefetchLevel(walk);
+		return true;
+	}
+private:
+	void prefetchLevel(const RankWalk &walk) const {
+		const uint64_t *words = this->m_tree.data();
+		__builtin_prefetch(words + (walk.nodeBegin >> 6));
+		__builtin_prefetch(words + ((walk.nodeBegin + walk.begin) >> 6));
+		__builtin_prefetch(words + ((walk.nodeBegin + walk.end) >> 6));
+	}
+};
+
+// the wavelet trees above, all others are stepped by sdsl's backward search one search after the other
+template<class t_wt>
+struct HasRankWalk: std::false_type {
+};
+template<class t_rank, class t_select, class t_select_zero>
+struct HasRankWalk<WalkableWtHuff<t_rank, t_select, t_select_zero>> : std::true_type {
+};
+template<class t_rank, class t_select, class t_select_zero>
+struct HasRankWalk<WalkableWtInt<t_rank, t_select, t_select_zero>> : std::true_type {
+};
+template<class t_rank, class t_select, class t_select_zero>
+struct HasRankWalk<WalkableWmInt<t_rank, t_select, t_select_zero>> : std::true_type {
+};
+
+template<class t_csa>
+class FMIndexVariant: public FMIndexInterface {
+public:
+	size_t size() const override {
+		return csa.size();
+	}
+	size_t sigma() const override {
+		return csa.sigma;
+	}
+	char symbol(size_t comp) const override {
+		return csa.comp2char[comp];
+	}
+	void extendInterval(size_t &begin, size_t &end, char base) const override {
+		typename t_csa::size_type l, r;
+		size_t occ = sdsl::backward_search(csa, begin, end - 1, base, l, r);
+		begin = l;
+		end = l + occ;
+	}
+	void extendIntervals(size_t *begin, size_t *end, const char *bases, size_t count) const override {
+		extendIntervals(begin, end, bases, count, HasRankWalk<typename t_csa::wavelet_tree_type>());
+	}
+	void load(std::istream &in) override {
+		csa.load(in);
+	}
+	void serialize(std::ostream &out) const override {
+		csa.serialize(out);
+	}
+	void construct(sdsl::cache_config &config) override {
+		t_csa tmp(config);
+		csa.swap(tmp);
+	}
+	double sizeInMegaBytes() const override {
+		return sdsl::size_in_mega_bytes(csa);
+	}
+private:
+	void extendIntervals(size_t *begin, size_t *end, const char *bases, size_t count, std::false_type) const {
+		for (size_t i = 0; i < count; ++i) {
+			extendInterval(begin[i], end[i], bases[i]);
+		}
+	}
+
+	// Like sdsl::backward_search, but the rank walks of up to RANK_WALK_BATCH_WIDTH steps advance level by level.
+	void extendIntervals(size_t *begin, size_t *end, const char *bases, size_t count, std::true_type) const {
+		static const size_t RANK_WALK_BATCH_WIDTH = 16;
+		typename t_csa::wavelet_tree_type::RankWalk walks[RANK_WALK_BATCH_WIDTH];
+		size_t symbolBegin[RANK_WALK_BATCH_WIDTH];
+		bool walking[RANK_WALK_BATCH_WIDTH];
+		const typename t_csa::wavelet_tree_type &wt = csa.wavelet_tree;
+
+		for (size_t first = 0; first < count; first += RANK_WALK_BATCH_WIDTH) {
+			size_t width = std::min(count - first, RANK_WALK_BATCH_WIDTH);
+			size_t numWalking = 0;
+			for (size_t i = 0; i < width; ++i) {
+				size_t &b = begin[first + i];
+				size_t &e = end[first + i];
+				unsigned char c = bases[first + i];
+				size_t comp = csa.char2comp[c];
+				walking[i] = false;
+				if (comp == 0 && c > 0) { // the symbol does not occur in the text
+					b = e = 1;
+				} else if (b == 0 && e == csa.size()) {
+					b = csa.C[comp];
+					e = csa.C[comp + 1];
+				} else {
+					symbolBegin[i] = csa.C[comp];
+					wt.startRankWalk(walks[i], c, b, e);
+					walking[i] = true;
+					numWalking++;
+				}
+			}
+			while (numWalking > 0) {
+				numWalking = 0;
+				for (size_t i = 0; i < width; ++i) {
+					if (walking[i] && wt.stepRankWalk(walks[i])) {
+						numWalking++;
+					}
+				}
+			}
+			for (size_t i = 0; i < width; ++i) {
+				if (walking[i]) {
+					begin[first + i] = symbolBegin[i] + walks[i].begin;
+					end[first + i] = symbolBegin[i] + walks[i].end;
+				}
+			}
+		}
+	}
+
+	t_csa csa;
+};
+
+typedef sdsl::csa_wt<
+		WalkableWtHuff<sdsl::rank_support_v5<>, sdsl::select_support_scan<>, sdsl::select_support_scan<0>>, 1 << 20,
+		1 << 20> FMIndexHuffCompact;
+typedef sdsl::csa_wt<sdsl::wt_huff<sdsl::rrr_vector<63>>, 1 << 20, 1 << 20> FMIndexHuffCompressed;
+typedef sdsl::csa_wt<
+		WalkableWtHuff<sdsl::rank_support_v<>, sdsl::select_support_mcl<1>, sdsl::select_support_mcl<0>>, 1 << 20,
+		1 << 20> FMIndexHuffFast;
+typedef sdsl::csa_wt<
+		WalkableWtInt<sdsl::rank_support_v<>, sdsl::select_support_mcl<1>, sdsl::select_support_mcl<0>>, 1 << 20,
+		1 << 20> FMIndexIntFast;
+typedef sdsl::csa_wt<
+		WalkableWmInt<sdsl::rank_support_v<>, sdsl::select_support_mcl<1>, sdsl::select_support_mcl<0>>, 1 << 20,
+		1 << 20> FMIndexMatrixFast;
+
+inline std::unique_ptr<FMIndexInterface> createFMIndex(FMIndexType type) {
+	switch (type) {
+	case FMIndexType::HUFF_COMPACT:
+		return std::unique_ptr<FMIndexInterface>(new FMIndexVariant<FMIndexHuffCompact>());
+	case FMIndexType::HUFF_COMPRESSED:
+		return std::unique_ptr<FMIndexInterface>(new FMIndexVariant<FMIndexHuffCompressed>());
+	case FMIndexType::HUFF_FAST:
+		return std::unique_ptr<FMIndexInterface>(new FMIndexVariant<FMIndexHuffFast>());
+	case FMIndexType::INT_FAST:
+		return std::unique_ptr<FMIndexInterface>(new FMIndexVariant<FMIndexIntFast>());
+	case FMIndexType::MATRIX_FAST:
+		return std::unique_ptr<FMIndexInterface>(new FMIndexVariant<FMIndexMatrixFast>());
+	default:
+		throw std::runtime_error("Unknown FM index type!");
+	}
+}
@@ -0,0 +1,126 @@
+/*
+ * KmerClassTable.cpp
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: sarah
+ */
+
+#include "KmerClassTable.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#include "PackedKmer.h"
+
+// written in front of a stored table
+static const char TABLE_MAGIC[8] = { 'P', 'A', 'E', 'C', 'K', 'C', 'L', '2' };
+// the classes start at this offset, so that the header can grow without moving them
+static const uint64_t CLASSES_OFFSET = 64;
+// marks the slots that are empty in the count table
+static const uint8_t NO_CLASS = 3;
+
+struct ClassTableHeader {
+	char magic[8];
+	uint32_t k;
+	uint32_t padding;
+	TextFileStamp textFileStamp;
+	uint64_t configHash;
+	uint64_t numSlots;
+	uint64_t numKmers;
+};
+
+KmerClassTable::KmerClassTable(const KmerCountTable &countTable, uint64_t configHash) :
+		countTable(countTable) {
+	this->configHash = configHash;
+	classes = NULL;
+}
+
+size_t KmerClassTable::getKmerSize() const {
+	return countTable.getKmerSize();
+}
+
+double KmerClassTable::sizeInMegaBytes() const {
+	return ((countTable.getNumSlots() + 3) / 4) / (1024.0 * 1024.0);
+}
+
+// Classifies every distinct k-mer of the count table by its canonical k-mer and count on all threads, so classify
+// has to be thread-safe. Every thread fills whole bytes of the table.
+void KmerClassTable::build(const std::function<KmerType(const std::string &kmer, size_t count)> &classify) {
+	size_t numSlots = countTable.getNumSlots();
+	size_t k = countTable.getKmerSize();
+	builtClasses.assign((numSlots + 3) / 4, 0);
+#pragma omp parallel for schedule(dynamic, 4096)
+	for (size_t b = 0; b < builtClasses.size(); ++b) {
+		uint8_t byte = 0;
+		for (size_t slot = 4 * b; slot < std::min(numSlots, 4 * b + 4); ++slot) {
+			uint64_t canonical;
+			uint8_t type = NO_CLASS;
+			if (countTable.kmerInSlot(slot, canonical)) {
+				type = kmerTypeToNumber(classify(unpackKmer(canonical, k), countTable.countKmer(canonical)));
+			}
+			byte |= type << (2 * (slot % 4));
+		}
+		builtClasses[b] = byte;
+	}
+	classes = builtClasses.data();
+}
+
+// false if the k-mer does not occur in the count table
+bool KmerClassTable::lookup(uint64_t packedKmer, KmerType &type) const {
+	size_t slot;
+	if (!classes || !countTable.findKmer(packedKmer, slot)) {
+		return false;
+	}
+	uint8_t number = (classes[slot / 4] >> (2 * (slot % 4))) & 3;
+	if (number == NO_CLASS) {
+		return false;
+	}
+	type = kmerTypeFromNumber(number);
+	return true;
+}
+
+// Maps the table if it belongs to the current reads, count table and configuration.
+bool KmerClassTable::loadTable(const std::string &tableFile, const TextFileStamp &textFileStamp) {
+	if (!mappedFile.open(tableFile)) {
+		return false;
+	}
+	size_t numBytes = (countTable.getNumSlots() + 3) / 4;
+	ClassTableHeader header;
+	if (mappedFile.size() != CLASSES_OFFSET + numBytes) {
+		mappedFile.close();
+		return false;
+	}
+	memcpy(&header, mappedFile.data(), sizeof(header));
+	if (!std::equal(header.magic, header.magic + sizeof(header.magic), TABLE_MAGIC)
+			|| header.k != countTable.getKmerSize() || header.textFileStamp != textFileStamp
+			|| header.configHash != configHash || header.numSlots != countTable.getNumSlots()
+			|| header.numKmers != countTable.getNumDistinctKmers()) {
+		mappedFile.close();
+		return false;
+	}
+	builtClasses.clear();
+	builtClasses.shrink_to_fit();
+	classes = (const uint8_t*) mappedFile.data() + CLASSES_OFFSET;
+	return true;
+}
+
+// The table is written to a temporary file first and renamed into place, as other processes may have mapped it.
+void KmerClassTable::storeTable(const std::string &tableFile, const TextFileStamp &textFileStamp) {
+	DerivedFileWriter writer(tableFile);
+	std::ofstream &outfile = writer.stream();
+	ClassTableHeader header;
+	memset(&header, 0, sizeof(header));
+	std::copy(TABLE_MAGIC, TABLE_MAGIC + sizeof(TABLE_MAGIC), header.magic);
+	header.k = countTable.getKmerSize();
+	header.textFileStamp = textFileStamp;
+	header.configHash = configHash;
+	header.numSlots = countTable.getNumSlots();
+	header.numKmers = countTable.getNumDistinctKmers();
+	std::vector<char> headerBytes(CLASSES_OFFSET, 0);
+	memcpy(headerBytes.data(), &header, sizeof(header));
+	outfile.write(headerBytes.data(), headerBytes.size());
+	outfile.write((const char*) builtClasses.data(), builtClasses.size());
+	writer.commit();
+}
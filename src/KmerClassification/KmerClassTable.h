@@ -0,0 +1,43 @@
+/*
+ * KmerClassTable.h
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: sarah
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "../DerivedFile.h"
+#include "KmerCountTable.h"
+#include "KmerType.h"
+#include "MappedFile.h"
+
+/*
+ * The classes of all distinct k-mers of a KmerCountTable, with 2 bits per slot of the count table, so a lookup costs
+ * one probe of the count table. The table is stored next to the count table under the hash of the configuration that
+ * classified it (coverage bias, classifier, ...), and is used from a read-only memory mapping, so that later runs on
+ * the same reads with the same configuration share it without classifying anything.
+ */
+class KmerClassTable {
+public:
+	KmerClassTable(const KmerCountTable &countTable, uint64_t configHash);
+	bool loadTable(const std::string &tableFile, const TextFileStamp &textFileStamp);
+	void build(const std::function<KmerType(const std::string &kmer, size_t count)> &classify);
+	void storeTable(const std::string &tableFile, const TextFileStamp &textFileStamp);
+	bool lookup(uint64_t packedKmer, KmerType &type) const;
+	size_t getKmerSize() const;
+	double sizeInMegaBytes() const;
+private:
+	const KmerCountTable &countTable;
+	uint64_t configHash;
+	std::vector<uint8_t> builtClasses; // 4 slots per byte, only used while the table is built
+	MappedFile mappedFile;
+	const uint8_t *classes; // 4 slots per byte
+};
@@ -0,0 +1,135 @@
+/*
+ * KmerClassificationCache.cpp
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: sarah
+ */
+
+#include "KmerClassificationCache.h"
+
+#include <algorithm>
+
+#include "PackedKmer.h"
+
+static const size_t NUM_CACHE_SHARDS = 64;
+
+KmerClassificationCache::KmerClassificationCache(size_t maxEntries) :
+		shards(NUM_CACHE_SHARDS) {
+	maxEntriesPerShard = std::max((size_t) 1, maxEntries / NUM_CACHE_SHARDS);
+}
+
+// The canonical k-mer preceded by a single set bit, which keeps k-mers of different sizes apart.
+bool KmerClassificationCache::cacheKey(const std::string &kmer, uint64_t &key) {
+	uint64_t packed;
+	if (kmer.empty() || !packKmer(kmer, packed)) {
+		return false;
+	}
+	key = cacheKey(packed, kmer.size());
+	return true;
+}
+
+uint64_t KmerClassificationCache::cacheKey(uint64_t packedKmer, size_t k) {
+	return (1ULL << (2 * k)) | canonicalPacked(packedKmer, k);
+}
+
+KmerClassificationCache::Shard& KmerClassificationCache::shardOf(uint64_t key) {
+	return shards[hashPacked(key) % NUM_CACHE_SHARDS];
+}
+
+bool KmerClassificationCache::lookup(const std::string &kmer, KmerType &type) {
+	uint64_t key;
+	if (!cacheKey(kmer, key)) {
+		return false;
+	}
+	return lookupKey(key, type);
+}
+
+bool KmerClassificationCache::lookup(uint64_t packedKmer, size_t k, KmerType &type) {
+	if (k == 0 || k > MAX_PACKED_KMER_SIZE) {
+		return false;
+	}
+	return lookupKey(cacheKey(packedKmer, k), type);
+}
+
+bool KmerClassificationCache::lookupKey(uint64_t key, KmerType &type) {
+	Shard &shard = shardOf(key);
+	std::lock_guard<std::mutex> lock(shard.mtx);
+	auto it = shard.slotOfKey.find(key);
+	if (it == shard.slotOfKey.end()) {
+		shard.misses++;
+		return false;
+	}
+	Entry &entry = shard.slots[it->second];
+	entry.referenced = true;
+	type = entry.type;
+	shard.hits++;
+	return true;
+}
+
+void KmerClassificationCache::insert(const std::string &kmer, KmerType type) {
+	uint64_t key;
+	if (!cacheKey(kmer, key)) {
+		return;
+	}
+	Shard &shard = shardOf(key);
+	std::lock_guard<std::mutex> lock(shard.mtx);
+	auto it = shard.slotOfKey.find(key);
+	if (it != shard.slotOfKey.end()) { // another thread has classified it in the meantime
+		shard.slots[it->second].type = type;
+		return;
+	}
+	if (shard.slots.size() < maxEntriesPerShard) {
+		shard.slotOfKey[key] = shard.slots.size();
+		shard.slots.push_back( { key, type, false });
+		return;
+	}
+	// CLOCK: entries used since the hand passed them get a second chance, the first other one is evicted
+	while (shard.slots[shard.clockHand].referenced) {
+		shard.slots[shard.clockHand].referenced = false;
+		shard.clockHand = (shard.clockHand + 1) % shard.slots.size();
+	}
+	Entry &victim = shard.slots[shard.clockHand];
+	shard.slotOfKey.erase(victim.key);
+	shard.slotOfKey[key] = shard.clockHand;
+	victim = {key, type, false};
+	shard.clockHand = (shard.clockHand + 1) % shard.slots.size();
+}
+
+void KmerClassificationCache::clear() {
+	for (Shard &shard : shards) {
+		std::lock_guard<std::mutex> lock(shard.mtx);
+		shard.slotOfKey.clear();
+		shard.slots.clear();
+		shard.clockHand = 0;
+	}
+}
+
+size_t KmerClassificationCache::numShards() const {
+	return shards.size();
+}
+
+size_t KmerClassificationCache::getNumHits(size_t shard) {
+	std::lock_guard<std::mutex> lock(shards[shard].mtx);
+	return shards[shard].hits;
+}
+
+size_t KmerClassificationCache::getNumMisses(size_t shard) {
+	std::lock_guard<std::mutex> lock(shards[shard].mtx);
+	return shards[shard].misses;
+}
+
+size_t KmerClassificationCache::getNumHits() {
+	size_t hits = 0;
+	for (size_t i = 0; i < shards.size(); ++i) {
+		hits += getNumHits(i);
+	}
+	return hits;
+}
+
+size_t KmerClassificationCache::getNumMisses() {
+	size_t misses = 0;
+	for (size_t i = 0; i < shards.size(); ++i) {
+		misses += getNumMisses(i);
+	}
+	return misses;
+}
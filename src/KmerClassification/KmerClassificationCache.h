@@ -0,0 +1,58 @@
+/*
+ * KmerClassificationCache.h
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: sarah
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "KmerType.h"
+
+/*
+ * Remembers the classes of recently classified k-mers, keyed by their 2-bit packed canonical k-mer, so that a k-mer and
+ * its reverse complement share an entry. Only k-mers of up to 31 bases over A, C, G and T are cached.
+ * The entries are spread over independently locked shards, so that correction threads rarely wait for each other.
+ * Every shard holds a bounded number of entries and evicts with the CLOCK algorithm, and counts its own hits and misses.
+ */
+class KmerClassificationCache {
+public:
+	KmerClassificationCache(size_t maxEntries = 1 << 22);
+	bool lookup(const std::string &kmer, KmerType &type);
+	bool lookup(uint64_t packedKmer, size_t k, KmerType &type); // the k-mer packed by packKmer, allocates no memory
+	void insert(const std::string &kmer, KmerType type);
+	void clear();
+	size_t numShards() const;
+	size_t getNumHits(size_t shard);
+	size_t getNumMisses(size_t shard);
+	size_t getNumHits();
+	size_t getNumMisses();
+private:
+	struct Entry {
+		uint64_t key;
+		KmerType type;
+		bool referenced;
+	};
+	struct Shard {
+		std::mutex mtx;
+		std::unordered_map<uint64_t, uint32_t> slotOfKey;
+		std::vector<Entry> slots;
+		size_t clockHand = 0;
+		size_t hits = 0;
+		size_t misses = 0;
+	};
+	static bool cacheKey(const std::string &kmer, uint64_t &key);
+	static uint64_t cacheKey(uint64_t packedKmer, size_t k);
+	bool lookupKey(uint64_t key, KmerType &type);
+	Shard& shardOf(uint64_t key);
+
+	size_t maxEntriesPerShard;
+	std::vector<Shard> shards;
+};
@@ -7,16 +7,59 @@
 
 #include "KmerClassificationUnit.h"
 
+#include <algorithm>
 #include <cmath>
 #include <fstream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <unordered_set>
 
+#include "PackedKmer.h"
 #include "../CoverageBias/PUSM.h"
 
+static const uint64_t TRAINING_DATA_SEED = 42;
+
+double gcContent(const std::string &kmer) {
+	int num = 0;
+	for (size_t i = 0; i < kmer.size(); ++i) {
+		if (kmer[i] == 'G' || kmer[i] == 'C') {
+			num++;
+		}
+	}
+	return (double) num / kmer.size();
+}
+
+// the class of a k-mer for CLASSIFICATION_CHEATING, which classifies by the count in the reference genome
+static KmerType classifyGenomeCount(size_t countGenome) {
+	if (countGenome == 0) {
+		return KmerType::UNTRUSTED;
+	} else if (countGenome == 1) {
+		return KmerType::TRUSTED;
+	} else {
+		return KmerType::REPEAT;
+	}
+}
+
+static double zScoreFromExpectation(size_t observedCount, double bias, const std::pair<double, double> &expected) {
+	double observedCountBiasCorrected = (1 / bias) * observedCount;
+	double z = (((double) observedCountBiasCorrected) - expected.first) / expected.second;
+	if (z != z) {
+		throw std::runtime_error(
+				"the z-score is not a number!!! observedCount: " + std::to_string(observedCount) + ", bias: "
+						+ std::to_string(bias) + ", observedCountBiasCorrected: "
+						+ std::to_string(observedCountBiasCorrected) + ", expected.first: "
+						+ std::to_string(expected.first) + ", expected.second: " + std::to_string(expected.second));
+	}
+	return z;
+}
+
 KmerClassificationUnit::KmerClassificationUnit(KmerCounter &kmerCounter, KmerCounter &refCounter, CoverageBiasUnit &biasUnitRef,
 		PerfectUniformSequencingModel &pusmRef, KmerClassificationType type) :
 		counter(kmerCounter), genomeCounter(refCounter), biasUnit(biasUnitRef), pusm(pusmRef) {
 	classificationType = type;
 	mlClassifier = NULL;
+	maxThresholdKmerSize = 0;
 	if (type == KmerClassificationType::CLASSIFICATION_MACHINE_LEARNING) {
 		PyObject* module = PyImport_ImportModule("blackbox_kmer");
 		
@@ -58,48 +101,63 @@ KmerClassificationUnit::KmerClassificationUnit(KmerCounter &kmerCounter, KmerCou
 	}
 }
 
+// Writes the best model of the Python classifier to modelFile and loads it into the native classifier.
+void KmerClassificationUnit::exportNativeClassifier(const std::string &modelFile) {
+	PyObject* res = PyObject_CallMethod(mlClassifier, (char*) "export_model", (char*) "s", modelFile.c_str());
+	if (!res) {
+		throw std::runtime_error("PYTHON: export_model failed");
+	}
+	if (!nativeClassifier.loadModel(modelFile)) {
+		throw std::runtime_error("Could not load the exported k-mer classifier: " + modelFile);
+	}
+	nativeModelFile = modelFile;
+}
+
 void KmerClassificationUnit::storeClassifier(const std::string &filename) {
 	if (classificationType == KmerClassificationType::CLASSIFICATION_MACHINE_LEARNING) {
 		PyObject* res = PyObject_CallMethod(mlClassifier, (char*) "store_classifier", (char*) "s", filename.c_str());
 		if (!res) {
 			throw std::runtime_error("PYTHON: store_classifier failed");
 		}
+		exportNativeClassifier(filename + ".model.txt");
 	}
 }
 
+// If the classifier has been exported for native inference, the Python model is not loaded at all.
 void KmerClassificationUnit::loadClassifier(const std::string &filename) {
 	if (classificationType == KmerClassificationType::CLASSIFICATION_MACHINE_LEARNING) {
-		PyObject* pyResultCurrent = PyObject_CallMethod(mlClassifier, (char*) "load_classifier", (char*) "s", filename.c_str());
-		if (!pyResultCurrent) {
-			throw std::runtime_error("PYTHON: load_classifier failed");
+		if (nativeClassifier.loadModel(filename + ".model.txt")) {
+			nativeModelFile = filename + ".model.txt";
+		} else {
+			PyObject* pyResultCurrent = PyObject_CallMethod(mlClassifier, (char*) "load_classifier", (char*) "s", filename.c_str());
+			if (!pyResultCurrent) {
+				throw std::runtime_error("PYTHON: load_classifier failed");
+			}
+			exportNativeClassifier(filename + ".model.txt");
 		}
+		clearCache();
 	}
 }
 
 void KmerClassificationUnit::trainClassifier(Dataset &ds, KmerCounter &genomeCounter) {
 	if (classificationType == KmerClassificationType::CLASSIFICATION_MACHINE_LEARNING) {
-		featureNames = "ZScore;gcContent;size;observedCount;biasCorrectedObservedCount;expectedCountPusm;type";
-		outputPath = ds.plotPath + "kmerTrainData.csv";
+		outputPath = ds.plotPath + "kmerTrainData.npy";
 
 		std::ifstream test(outputPath);
 		if (test.good()) {
 			std::cout << "Alread detected k-mer training data. Skipping extraction...\n";
 		} else {
-			std::ofstream outfile(outputPath);
-			if (!outfile.good()) {
-				throw std::runtime_error("Could not create file: " + outputPath);
-			}
-			outfile << featureNames << "\n";
-
 			std::cout << "Extracting training data for k-mer classification...\n";
+			std::vector<TrainingSample> samples;
 			if (length(ds.genome) > 0) { // use reference genome for grabbing k-mers
-				extractTrainingDataFromReference(ds.genome, biasUnit.getMinKmerSize(), genomeCounter, outfile);
+				extractTrainingDataFromReference(ds.genome, biasUnit.getMinKmerSize(), genomeCounter,
+						TRAINING_DATA_SEED, samples);
 			} else { // use read dataset for grabbing k-mers? Not sure how, though...
 				throw std::runtime_error(
 						"Cannot train k-mer classification unit, the reference genome is not provided!");
 			}
+			writeTrainingData(outputPath, samples);
 			std::cout << "Finished extracting training data for k-mer classification.\n";
-			outfile.close();
 		}
 
 		std::cout << "Choosing the best classifier...\n";
@@ -107,146 +165,210 @@ void KmerClassificationUnit::trainClassifier(Dataset &ds, KmerCounter &genomeCou
 		if (!pyResultCurrent) {
 			throw std::runtime_error("PYTHON: set_csv_file failed");
 		}
+		exportNativeClassifier(outputPath + ".model.txt");
+		clearCache();
 		std::cout << "Finished choosing the best classifier.\n";
 	}
 }
 
+// Every chunk of candidate k-mers has its own generator, seeded with the seed and the chunk number, so that the
+// sampled k-mers do not depend on the number of threads.
+static std::mt19937_64 chunkGenerator(uint64_t seed, size_t chunk) {
+	std::seed_seq seq { (uint32_t) seed, (uint32_t) (seed >> 32), (uint32_t) chunk, (uint32_t) (chunk >> 32) };
+	return std::mt19937_64(seq);
+}
+
+// the packed k-mer with its size, false if the k-mer contains a character other than A, C, G, T
+static bool sampleKey(const std::string &kmer, uint64_t &key) {
+	uint64_t packed;
+	if (packKmer(kmer, packed)) {
+		key = (1ULL << (2 * kmer.size())) | packed;
+		return true;
+	}
+	if (kmer.find_first_not_of("ACGT") != std::string::npos) {
+		return false;
+	}
+	// longer k-mers are told apart by a hash, a collision only drops a sample
+	key = (1ULL << 63) | (std::hash<std::string>()(kmer) >> 1);
+	return true;
+}
+
+// counts the k-mers in batches on all threads
+static std::vector<size_t> countKmersInParallel(KmerCounter &kmerCounter, const std::vector<std::string> &kmers,
+		bool withReverseComplement) {
+	static const size_t KMERS_PER_BATCH = 1024;
+	std::vector<size_t> counts(kmers.size());
+	size_t numBatches = (kmers.size() + KMERS_PER_BATCH - 1) / KMERS_PER_BATCH;
+#pragma omp parallel for schedule(dynamic, 1)
+	for (size_t b = 0; b < numBatches; ++b) {
+		std::vector<std::string> batch(kmers.begin() + b * KMERS_PER_BATCH,
+				kmers.begin() + std::min(kmers.size(), (b + 1) * KMERS_PER_BATCH));
+		std::vector<size_t> batchCounts =
+				withReverseComplement ? kmerCounter.countKmers(batch) : kmerCounter.countKmersNoRC(batch);
+		std::copy(batchCounts.begin(), batchCounts.end(), counts.begin() + b * KMERS_PER_BATCH);
+	}
+	return counts;
+}
+
+// Samples about a third of the training k-mers from the reference genome and the rest at random among the k-mers that
+// occur in the reads, without duplicates. The candidates are drawn and counted in rounds of chunks on all threads,
+// and taken over in the order of the chunks, so the samples only depend on the seed. If too many candidates in a row
+// are duplicates or absent from the reads, the k-mer size is increased.
 void KmerClassificationUnit::extractTrainingDataFromReference(const seqan::Dna5String &referenceGenome, size_t k,
-		KmerCounter &referenceCounter, std::ofstream &outfile) {
-	std::unordered_set<std::string> visitedKmers;
+		KmerCounter &referenceCounter, uint64_t seed, std::vector<TrainingSample> &samples) {
+	static const size_t KMERS_PER_CHUNK = 1024;
+	static const size_t CHUNKS_PER_ROUND = 64;
+	std::unordered_set<uint64_t> visitedKmers;
 
-	size_t min_progress = 0;
 	size_t num_entries = std::min(500000.0, std::pow(4.0, k) / 2);
+	size_t maxK = length(referenceGenome) / 2;
 	size_t oldK = k;
 	size_t numKmerResets = 0;
 	size_t maxNumKmerResets = 100;
 
 	size_t numFailed = 0;
 	size_t maxFailed = 100000;
+	size_t nextChunk = 0;
 
 	// ensure approximately 1/3 trusted or repetitive k-mers; by using the genome.
-	while (visitedKmers.size() < num_entries / 3 && numKmerResets < maxNumKmerResets) {
-		size_t randomPosition = rand() % (length(referenceGenome) - k);
-		std::string randomKmer = "";
-		for (size_t i = 0; i < k; ++i) {
-			randomKmer += referenceGenome[randomPosition + i];
-			if (visitedKmers.find(randomKmer) == visitedKmers.end()) {
-				int numGC = 0;
+	while (samples.size() < num_entries / 3 && numKmerResets < maxNumKmerResets) {
+		std::vector<std::vector<std::string> > candidates(CHUNKS_PER_ROUND);
+#pragma omp parallel for schedule(dynamic, 1)
+		for (size_t c = 0; c < CHUNKS_PER_ROUND; ++c) {
+			std::mt19937_64 generator = chunkGenerator(seed, nextChunk + c);
+			std::uniform_int_distribution<size_t> randomPosition(0, length(referenceGenome) - k - 1);
+			for (size_t i = 0; i < KMERS_PER_CHUNK; ++i) {
+				size_t pos = randomPosition(generator);
+				std::string kmer(k, 'N');
 				for (size_t j = 0; j < k; ++j) {
-					if (randomKmer[j] == 'G' || randomKmer[j] == 'C') {
-						numGC++;
-					}
+					kmer[j] = referenceGenome[pos + j];
 				}
-				double gc = (double) numGC / k;
-				size_t covGenome = referenceCounter.countKmerNoRC(randomKmer);
-				double covObserved = counter.countKmer(randomKmer);
-				double covExpected = pusm.expectedCount(randomKmer).first;
-				double covBiasCorrected = 1.0 / biasUnit.getBias(randomKmer) * covObserved;
-				double zScore = kmerZScore(randomKmer);
-				if (covGenome == 0) {
-					writeTrainingString(zScore, gc, k, covObserved, covBiasCorrected, covExpected, KmerType::UNTRUSTED,
-							outfile);
-				} else if (covGenome == 1) {
-					writeTrainingString(zScore, gc, k, covObserved, covBiasCorrected, covExpected, KmerType::TRUSTED,
-							outfile);
-				} else {
-					writeTrainingString(zScore, gc, k, covObserved, covBiasCorrected, covExpected, KmerType::REPEAT,
-							outfile);
-				}
-				visitedKmers.insert(randomKmer);
-			} else {
-				numFailed++;
-				if (numFailed >= maxFailed) {
+				candidates[c].push_back(kmer);
+			}
+		}
+		nextChunk += CHUNKS_PER_ROUND;
+
+		std::vector<std::string> accepted;
+		bool sizeChanged = false;
+		for (size_t c = 0; c < CHUNKS_PER_ROUND && !sizeChanged; ++c) {
+			for (size_t i = 0; i < candidates[c].size() && samples.size() + accepted.size() < num_entries / 3; ++i) {
+				uint64_t key;
+				if (sampleKey(candidates[c][i], key) && visitedKmers.insert(key).second) {
+					accepted.push_back(candidates[c][i]);
+					numFailed = 0;
+				} else if (++numFailed >= maxFailed) {
+					numFailed = 0;
 					k += 2;
-					if (k > length(referenceGenome) / 2) {
+					if (k > maxK) {
 						k = oldK;
 						numKmerResets++;
 					}
+					sizeChanged = true;
 					break;
 				}
 			}
 		}
-
-		double progress = 100.0 * (double) visitedKmers.size() / num_entries;
-		if (progress >= min_progress) {
-			std::cout << progress << "%\n";
-			min_progress++;
-		}
+		appendTrainingSamples(accepted, countKmersInParallel(counter, accepted, true), referenceCounter, samples);
+		std::cout << 100.0 * (double) samples.size() / num_entries << "%\n";
 	}
 
 	numFailed = 0;
 	numKmerResets = 0;
 
 	k = oldK;
-	while (visitedKmers.size() < num_entries && numKmerResets < maxNumKmerResets) {
-		std::string randomKmer = "";
-		for (size_t j = 0; j < k; ++j) {
-			int randomValue = rand() % 4;
-			switch (randomValue) {
-			case 0:
-				randomKmer += "A";
-				break;
-			case 1:
-				randomKmer += "C";
-				break;
-			case 2:
-				randomKmer += "G";
-				break;
-			default:
-				randomKmer += "T";
-				break;
+	while (samples.size() < num_entries && numKmerResets < maxNumKmerResets) {
+		std::vector<std::vector<std::string> > candidates(CHUNKS_PER_ROUND);
+		std::vector<std::vector<size_t> > candidateCounts(CHUNKS_PER_ROUND);
+#pragma omp parallel for schedule(dynamic, 1)
+		for (size_t c = 0; c < CHUNKS_PER_ROUND; ++c) {
+			std::mt19937_64 generator = chunkGenerator(seed, nextChunk + c);
+			std::uniform_int_distribution<int> randomBase(0, 3);
+			for (size_t i = 0; i < KMERS_PER_CHUNK; ++i) {
+				std::string kmer(k, 'A');
+				for (size_t j = 0; j < k; ++j) {
+					kmer[j] = unpackBase(randomBase(generator));
+				}
+				candidates[c].push_back(kmer);
 			}
+			candidateCounts[c] = counter.countKmers(candidates[c]);
 		}
-		if (visitedKmers.find(randomKmer) == visitedKmers.end()) {
-			double covObserved = counter.countKmer(randomKmer);
-			if (covObserved == 0) {
-				numFailed++;
-				if (numFailed >= maxFailed) {
-					k += 2;
-					numKmerResets++;
-					if (k > length(referenceGenome) / 2) {
-						k = oldK;
-					}
+		nextChunk += CHUNKS_PER_ROUND;
+
+		std::vector<std::string> accepted;
+		std::vector<size_t> acceptedCounts;
+		bool sizeChanged = false;
+		for (size_t c = 0; c < CHUNKS_PER_ROUND && !sizeChanged; ++c) {
+			for (size_t i = 0; i < candidates[c].size() && samples.size() + accepted.size() < num_entries; ++i) {
+				uint64_t key;
+				sampleKey(candidates[c][i], key);
+				if (visitedKmers.find(key) != visitedKmers.end()) {
+					continue;
 				}
-				continue;
-			}
-			numFailed = 0;
-			int numGC = 0;
-			for (size_t j = 0; j < k; ++j) {
-				if (randomKmer[j] == 'G' || randomKmer[j] == 'C') {
-					numGC++;
+				if (candidateCounts[c][i] == 0) {
+					if (++numFailed >= maxFailed) {
+						numFailed = 0;
+						k += 2;
+						numKmerResets++;
+						if (k > maxK) {
+							k = oldK;
+						}
+						sizeChanged = true;
+						break;
+					}
+					continue;
 				}
+				numFailed = 0;
+				visitedKmers.insert(key);
+				accepted.push_back(candidates[c][i]);
+				acceptedCounts.push_back(candidateCounts[c][i]);
 			}
-			double gc = (double) numGC / k;
-			size_t covGenome = referenceCounter.countKmerNoRC(randomKmer);
-			double covExpected = pusm.expectedCount(randomKmer).first;
-			double covBiasCorrected = 1.0 / biasUnit.getBias(randomKmer) * covObserved;
-			double zScore = kmerZScore(randomKmer);
-			if (covGenome == 0) {
-				writeTrainingString(zScore, gc, k, covObserved, covBiasCorrected, covExpected, KmerType::UNTRUSTED,
-						outfile);
-			} else if (covGenome == 1) {
-				writeTrainingString(zScore, gc, k, covObserved, covBiasCorrected, covExpected, KmerType::TRUSTED,
-						outfile);
-			} else {
-				writeTrainingString(zScore, gc, k, covObserved, covBiasCorrected, covExpected, KmerType::REPEAT,
-						outfile);
-			}
-			visitedKmers.insert(randomKmer);
 		}
+		appendTrainingSamples(accepted, acceptedCounts, referenceCounter, samples);
+		std::cout << 100.0 * (double) samples.size() / num_entries << "%\n";
+	}
+}
 
-		double progress = 100.0 * (double) visitedKmers.size() / num_entries;
-		if (progress >= min_progress) {
-			std::cout << progress << "%\n";
-			min_progress++;
-		}
+// Labels the k-mers by their count in the reference genome and appends their features.
+void KmerClassificationUnit::appendTrainingSamples(const std::vector<std::string> &kmers,
+		const std::vector<size_t> &observedCounts, KmerCounter &referenceCounter, std::vector<TrainingSample> &samples) {
+	std::vector<size_t> genomeCounts = countKmersInParallel(referenceCounter, kmers, false);
+	for (size_t i = 0; i < kmers.size(); ++i) {
+		double bias = biasUnit.getBias(kmers[i]);
+		std::pair<double, double> expected = pusm.expectedCount(kmers[i]);
+		TrainingSample sample;
+		sample.zScore = zScoreFromExpectation(observedCounts[i], bias, expected);
+		sample.gcContent = gcContent(kmers[i]);
+		sample.size = kmers[i].size();
+		sample.observedCount = observedCounts[i];
+		sample.biasCorrectedObservedCount = 1.0 / bias * observedCounts[i];
+		sample.expectedCountPusm = expected.first;
+		sample.type = kmerTypeToNumber(classifyGenomeCount(genomeCounts[i]));
+		samples.push_back(sample);
 	}
 }
 
-void KmerClassificationUnit::writeTrainingString(double zScore, double gc, size_t k, double countObserved,
-		double countBiasCorrected, double countExpectedPusm, KmerType type, std::ofstream &outfile) {
-	outfile << zScore << ";" << gc << ";" << k << ";" << countObserved << ";" << countBiasCorrected << ";"
-			<< countExpectedPusm << ";" << kmerTypeToNumber(type) << "\n";
+// Writes the samples as a NumPy array of records with one field per column, which blackbox_kmer.py memory-maps.
+void KmerClassificationUnit::writeTrainingData(const std::string &filename, const std::vector<TrainingSample> &samples) {
+	std::ofstream outfile(filename, std::ios::binary);
+	if (!outfile.good()) {
+		throw std::runtime_error("Could not create file: " + filename);
+	}
+	std::string header = "{'descr': [('ZScore', '<f8'), ('gcContent', '<f8'), ('size', '<f8'), "
+			"('observedCount', '<f8'), ('biasCorrectedObservedCount', '<f8'), ('expectedCountPusm', '<f8'), "
+			"('type', '<f8')], 'fortran_order': False, 'shape': (" + std::to_string(samples.size()) + ",), }";
+	// magic string, version and header length take 10 bytes, the data starts at a multiple of 64 bytes
+	while ((10 + header.size() + 1) % 64 != 0) {
+		header += ' ';
+	}
+	header += '\n';
+	uint16_t headerLength = header.size();
+	outfile.write("\x93NUMPY\x01\x00", 8);
+	outfile.write((const char*) &headerLength, sizeof(headerLength));
+	outfile.write(header.data(), header.size());
+	outfile.write((const char*) samples.data(), samples.size() * sizeof(TrainingSample));
+	if (!outfile.good()) {
+		throw std::runtime_error("Could not write file: " + filename);
+	}
 }
 
 KmerType KmerClassificationUnit::classifyZScore(double zScore) {
@@ -259,14 +381,11 @@ KmerType KmerClassificationUnit::classifyZScore(double zScore) {
 	}
 }
 
-double gcContent(const std::string &kmer) {
-	int num = 0;
-	for (size_t i = 0; i < kmer.size(); ++i) {
-		if (kmer[i] == 'G' || kmer[i] == 'C') {
-			num++;
-		}
+KmerCursor KmerClassificationUnit::startCursor(const std::string &kmer) {
+	if (classificationType == KmerClassificationType::CLASSIFICATION_CHEATING) {
+		return genomeCounter.startCursor(kmer);
 	}
-	return (double) num / kmer.size();
+	return counter.startCursor(kmer);
 }
 
 KmerType KmerClassificationUnit::classifyKmer(const std::string &kmer) {
@@ -275,19 +394,164 @@ KmerType KmerClassificationUnit::classifyKmer(const std::string &kmer) {
 		throw std::runtime_error("K-mer classification called with an invalid k-mer!");
 	}
 
-	/*if (cachedClassifications.find(kmer) != cachedClassifications.end()) {
-		return cachedClassifications[kmer];
-	}*/
+	KmerType type;
+	if (lookupClassTable(kmer, type) || cachedClassifications.lookup(kmer, type)) {
+		return type;
+	}
 
-	if (classificationType == KmerClassificationType::CLASSIFICATION_STATISTICAL) {
-		KmerType type = classifyZScore(kmerZScore(kmer));
-		//cachedClassifications[kmer] = type;
+	size_t observedCount;
+	CountThresholds thresholds;
+	if (classificationType == KmerClassificationType::CLASSIFICATION_CHEATING) {
+		if (lookupReferenceTable(kmer, type)) {
+			return type;
+		}
+		observedCount = genomeCounter.countKmer(kmer);
+	} else if (thresholdsOf(kmer.size(), std::count(kmer.begin(), kmer.end(), 'G') + std::count(kmer.begin(), kmer.end(), 'C'),
+			thresholds)) {
+		// the class is known once the count reaches the repeat threshold or falls below the trusted one, and without
+		// counting if it cannot reach the trusted threshold
+		if (!counter.mayOccurAtLeast(kmer, thresholds.minTrusted)) {
+			type = KmerType::UNTRUSTED;
+		} else {
+			type = classifyByThresholds(thresholds,
+					counter.countKmerUpTo(kmer, thresholds.minTrusted, thresholds.minRepeat));
+		}
+		cachedClassifications.insert(kmer, type);
 		return type;
+	} else {
+		observedCount = counter.countKmer(kmer);
+	}
+	return classifyCounted(kmer, observedCount);
+}
+
+// the cursor has been started by startCursor(), so it already counts in the right index
+KmerType KmerClassificationUnit::classifyKmer(const KmerCursor &cursor) {
+	// check if the k-mer is invalid
+	if (cursor.kmer().find("_") != std::string::npos) {
+		throw std::runtime_error("K-mer classification called with an invalid k-mer!");
+	}
+	KmerType type;
+	if (lookupReferenceTable(cursor.kmer(), type) || lookupClassTable(cursor.kmer(), type)
+			|| cachedClassifications.lookup(cursor.kmer(), type)) {
+		return type;
+	}
+	return classifyCounted(cursor.kmer(), cursor.count());
+}
+
+static void applyExtensions(KmerCursor &cursor, const std::vector<KmerExtension> &extensions, size_t from, size_t to) {
+	for (size_t i = from; i < to; ++i) {
+		if (extensions[i].left) {
+			cursor.extendLeft(extensions[i].base);
+		} else {
+			cursor.extendRight(extensions[i].base);
+		}
+	}
+}
+
+// Grows the REPEAT k-mer of the cursor by the extensions, in their order, and finds the first checkpoint (a number of
+// applied extensions, in increasing order) at which it is no longer REPEAT. The cursor is left at that checkpoint, or
+// at the last one if the k-mer stays REPEAT, and numExtended is set to its number of extensions (0 if there are no
+// checkpoints).
+// The count of a k-mer can only fall as it grows, but the statistical and naive repeat thresholds fall with the k-mer
+// size as well, so a k-mer that is no longer REPEAT may be REPEAT again after a few more extensions. These k-mers are
+// classified at every checkpoint in turn, continuing the search of the cursor.
+// Only the reference multiplicity of CLASSIFICATION_CHEATING is repetitive from a fixed count on, for every k-mer size.
+// There, the search gallops over 1, 2, 4, ... checkpoints until the k-mer is no longer REPEAT and then bisects between
+// that checkpoint and the last REPEAT one, which needs a logarithmic number of classifications and finds the same
+// checkpoint. Each probe continues from a copy of the cursor of the last REPEAT checkpoint, so a prefix is never
+// searched again from scratch.
+KmerType KmerClassificationUnit::classifyGrowingKmer(KmerCursor &cursor, const std::vector<KmerExtension> &extensions,
+		const std::vector<size_t> &checkpoints, size_t &numExtended) {
+	// the number of extensions after passing the first j checkpoints
+	auto extensionsAt = [&checkpoints](size_t j) {
+		return (j == 0) ? 0 : checkpoints[j - 1];
+	};
+	size_t numCheckpoints = checkpoints.size();
+	if (classificationType != KmerClassificationType::CLASSIFICATION_CHEATING) {
+		numExtended = 0;
+		for (size_t j = 1; j <= numCheckpoints; ++j) {
+			applyExtensions(cursor, extensions, extensionsAt(j - 1), extensionsAt(j));
+			numExtended = extensionsAt(j);
+			KmerType type = classifyKmer(cursor);
+			if (type != KmerType::REPEAT) {
+				return type;
+			}
+		}
+		return KmerType::REPEAT;
+	}
+	size_t lo = 0; // the number of checkpoints known to be REPEAT
+	KmerCursor loCursor = cursor;
+	size_t hi = 0; // the number of checkpoints up to the first known one that is not REPEAT, 0 if there is none yet
+	KmerCursor hiCursor;
+	KmerType hiType = KmerType::REPEAT;
+	size_t stride = 1;
+	while (lo < numCheckpoints) {
+		size_t probe = std::min(lo + stride, numCheckpoints);
+		KmerCursor probeCursor = loCursor;
+		applyExtensions(probeCursor, extensions, extensionsAt(lo), extensionsAt(probe));
+		KmerType type = classifyKmer(probeCursor);
+		if (type != KmerType::REPEAT) {
+			hi = probe;
+			hiCursor = std::move(probeCursor);
+			hiType = type;
+			break;
+		}
+		lo = probe;
+		loCursor = std::move(probeCursor);
+		stride *= 2;
+	}
+	if (hi == 0) {
+		cursor = std::move(loCursor);
+		numExtended = extensionsAt(lo);
+		return KmerType::REPEAT;
+	}
+	while (hi - lo > 1) {
+		size_t mid = lo + (hi - lo) / 2;
+		KmerCursor midCursor = loCursor;
+		applyExtensions(midCursor, extensions, extensionsAt(lo), extensionsAt(mid));
+		KmerType type = classifyKmer(midCursor);
+		if (type == KmerType::REPEAT) {
+			lo = mid;
+			loCursor = std::move(midCursor);
+		} else {
+			hi = mid;
+			hiCursor = std::move(midCursor);
+			hiType = type;
+		}
+	}
+	cursor = std::move(hiCursor);
+	numExtended = extensionsAt(hi);
+	return hiType;
+}
+
+// The class of a k-mer only depends on its canonical count, GC content and size, which are the same for its reverse
+// complement, so it is cached for both.
+KmerType KmerClassificationUnit::classifyCounted(const std::string &kmer, size_t observedCount) {
+	KmerType type = classifyCountedUncached(kmer, observedCount);
+	cachedClassifications.insert(kmer, type);
+	return type;
+}
+
+// observedCount is the count in the reference genome for CLASSIFICATION_CHEATING, and the count in the reads otherwise
+KmerType KmerClassificationUnit::classifyCountedUncached(const std::string &kmer, size_t observedCount) {
+	if (classificationType == KmerClassificationType::CLASSIFICATION_CHEATING) {
+		return classifyGenomeCount(observedCount);
+	}
+	CountThresholds thresholds;
+	if (thresholdsOf(kmer.size(), std::count(kmer.begin(), kmer.end(), 'G') + std::count(kmer.begin(), kmer.end(), 'C'),
+			thresholds)) {
+		return classifyByThresholds(thresholds, observedCount);
+	}
+	return classifyWithExpectation(kmer, observedCount, biasUnit.getBias(kmer), pusm.expectedCount(kmer));
+}
+
+// bias and expected are the coverage bias and the PUSM expectation of the k-mer
+KmerType KmerClassificationUnit::classifyWithExpectation(const std::string &kmer, size_t observedCount, double bias,
+		const std::pair<double, double> &expected) {
+	if (classificationType == KmerClassificationType::CLASSIFICATION_STATISTICAL) {
+		return classifyZScore(zScoreFromExpectation(observedCount, bias, expected));
 	} else if (classificationType == KmerClassificationType::CLASSIFICATION_NAIVE) {
-		double bias = biasUnit.getBias(kmer);
-		size_t observedCount = counter.countKmer(kmer);
 		double observedCountBiasCorrected = (1 / bias) * observedCount;
-		std::pair<double, double> expected = pusm.expectedCount(kmer);
 		double expectedCountUnique = expected.first;
 		KmerType type;
 		if (observedCountBiasCorrected < 0.5 * expectedCountUnique) {
@@ -297,22 +561,12 @@ KmerType KmerClassificationUnit::classifyKmer(const std::string &kmer) {
 		} else {
 			type = KmerType::REPEAT;
 		}
-		//cachedClassifications[kmer] = type;
 		return type;
 	} else if (classificationType == KmerClassificationType::CLASSIFICATION_MACHINE_LEARNING) {
-		// build feature vector
-		std::vector<double> features;
-		features.push_back(kmerZScore(kmer));
-		features.push_back(gcContent(kmer));
-		features.push_back(kmer.size());
-		size_t observedCount = counter.countKmer(kmer);
-		features.push_back(observedCount);
-		double bias = biasUnit.getBias(kmer);
-		double observedCountBiasCorrected = (1 / bias) * observedCount;
-		features.push_back(observedCountBiasCorrected);
-		std::pair<double, double> expected = pusm.expectedCount(kmer);
-		double expectedCountUnique = expected.first;
-		features.push_back(expectedCountUnique);
+		std::vector<double> features = machineLearningFeatures(kmer, observedCount, bias, expected);
+		if (nativeClassifier.isLoaded()) {
+			return kmerTypeFromNumber(nativeClassifier.classify(features));
+		}
 		// convert the vector into Python object
 		PyObject* pyFeatures = PyList_New(features.size());
 		for (size_t i = 0; i < features.size(); ++i) {
@@ -332,58 +586,506 @@ KmerType KmerClassificationUnit::classifyKmer(const std::string &kmer) {
 
 		//PyGILState_Release(gstate);
 
-		KmerType kmerType = kmerTypeFromNumber(typeAsInt);
-		//cachedClassifications[kmer] = kmerType;
-
-		return kmerType;
-	} else if (classificationType == KmerClassificationType::CLASSIFICATION_CHEATING) {
-		KmerType kmerType;
-		size_t countGenome = genomeCounter.countKmer(kmer);
-		if (countGenome == 0) {
-			kmerType = KmerType::UNTRUSTED;
-		} else if (countGenome == 1) {
-			kmerType = KmerType::TRUSTED;
-		} else {
-			kmerType = KmerType::REPEAT;
-		}
-		//cachedClassifications[kmer] = kmerType;
-		
-		return kmerType;
+		return kmerTypeFromNumber(typeAsInt);
 	} else {
 		throw std::runtime_error("Unknown classification type");
 	}
 }
 
+// ZScore, gcContent, size, observedCount, biasCorrectedObservedCount, expectedCountPusm
+std::vector<double> KmerClassificationUnit::machineLearningFeatures(const std::string &kmer, size_t observedCount,
+		double bias, const std::pair<double, double> &expected) {
+	std::vector<double> features;
+	features.push_back(zScoreFromExpectation(observedCount, bias, expected));
+	features.push_back(gcContent(kmer));
+	features.push_back(kmer.size());
+	features.push_back(observedCount);
+	double observedCountBiasCorrected = (1 / bias) * observedCount;
+	features.push_back(observedCountBiasCorrected);
+	double expectedCountUnique = expected.first;
+	features.push_back(expectedCountUnique);
+	return features;
+}
+
+// Classifies all feature rows with the native classifier, or with a single call into the Python classifier.
+void KmerClassificationUnit::classifyMachineLearningBatch(const std::vector<std::vector<double> > &featureRows,
+		std::vector<KmerType> &types) {
+	types.resize(featureRows.size());
+	if (nativeClassifier.isLoaded()) {
+		for (size_t i = 0; i < featureRows.size(); ++i) {
+			types[i] = kmerTypeFromNumber(nativeClassifier.classify(featureRows[i]));
+		}
+		return;
+	}
+	PyObject* pyRows = PyList_New(featureRows.size());
+	for (size_t i = 0; i < featureRows.size(); ++i) {
+		PyObject* pyFeatures = PyList_New(featureRows[i].size());
+		for (size_t j = 0; j < featureRows[i].size(); ++j) {
+			PyList_SetItem(pyFeatures, j, PyFloat_FromDouble(featureRows[i][j]));
+		}
+		PyList_SetItem(pyRows, i, pyFeatures);
+	}
+	PyObject* pyResult = PyObject_CallMethod(mlClassifier, (char*) "classify_all", (char*) "O", pyRows);
+	Py_DECREF(pyRows);
+	if (!pyResult) {
+		throw std::runtime_error("PYTHON: classify_all failed");
+	}
+	for (size_t i = 0; i < featureRows.size(); ++i) {
+		types[i] = kmerTypeFromNumber(PyInt_AsLong(PyList_GetItem(pyResult, i)));
+	}
+	Py_DECREF(pyResult);
+}
+
+// Same results as calling classifyKmer on every k-mer of the batch. The k-mers that are not cached are counted in one
+// batch, and since the coverage bias only depends on the GC content and the PUSM expectation only on the k-mer size,
+// those are computed once per distinct value instead of once per k-mer.
+std::vector<KmerType> KmerClassificationUnit::classifyKmers(const std::vector<std::string> &kmers) {
+	std::vector<KmerType> types(kmers.size());
+	std::vector<size_t> uncached;
+	std::vector<std::string> uncachedKmers;
+	for (size_t i = 0; i < kmers.size(); ++i) {
+		// check if the k-mer is invalid
+		if (kmers[i].find("_") != std::string::npos) {
+			throw std::runtime_error("K-mer classification called with an invalid k-mer!");
+		}
+		if (!lookupReferenceTable(kmers[i], types[i]) && !lookupClassTable(kmers[i], types[i])
+				&& !cachedClassifications.lookup(kmers[i], types[i])) {
+			uncached.push_back(i);
+			uncachedKmers.push_back(kmers[i]);
+		}
+	}
+	if (uncached.empty()) {
+		return types;
+	}
+
+	std::vector<size_t> counts;
+	if (classificationType == KmerClassificationType::CLASSIFICATION_CHEATING) {
+		counts = genomeCounter.countKmers(uncachedKmers);
+		for (size_t i = 0; i < uncached.size(); ++i) {
+			types[uncached[i]] = classifyGenomeCount(counts[i]);
+		}
+	} else {
+		counts = counter.countKmers(uncachedKmers);
+		std::map<std::pair<size_t, size_t>, double> biasOfSizeAndGC;
+		std::map<size_t, std::pair<double, double> > expectedOfSize;
+		std::vector<double> biases(uncached.size());
+		std::vector<std::pair<double, double> > expectations(uncached.size());
+		std::vector<bool> classified(uncached.size(), false);
+		for (size_t i = 0; i < uncached.size(); ++i) {
+			const std::string &kmer = uncachedKmers[i];
+			size_t numGC = std::count(kmer.begin(), kmer.end(), 'G') + std::count(kmer.begin(), kmer.end(), 'C');
+			CountThresholds thresholds;
+			if (thresholdsOf(kmer.size(), numGC, thresholds)) {
+				types[uncached[i]] = classifyByThresholds(thresholds, counts[i]);
+				classified[i] = true;
+				continue;
+			}
+			auto biasIt = biasOfSizeAndGC.find(std::make_pair(kmer.size(), numGC));
+			if (biasIt == biasOfSizeAndGC.end()) {
+				biasIt = biasOfSizeAndGC.insert(std::make_pair(std::make_pair(kmer.size(), numGC), biasUnit.getBias(kmer))).first;
+			}
+			biases[i] = biasIt->second;
+			auto expectedIt = expectedOfSize.find(kmer.size());
+			if (expectedIt == expectedOfSize.end()) {
+				expectedIt = expectedOfSize.insert(std::make_pair(kmer.size(), pusm.expectedCount(kmer))).first;
+			}
+			expectations[i] = expectedIt->second;
+		}
+
+		if (classificationType == KmerClassificationType::CLASSIFICATION_MACHINE_LEARNING) {
+			std::vector<std::vector<double> > featureRows(uncached.size());
+			for (size_t i = 0; i < uncached.size(); ++i) {
+				featureRows[i] = machineLearningFeatures(uncachedKmers[i], counts[i], biases[i], expectations[i]);
+			}
+			std::vector<KmerType> uncachedTypes;
+			classifyMachineLearningBatch(featureRows, uncachedTypes);
+			for (size_t i = 0; i < uncached.size(); ++i) {
+				types[uncached[i]] = uncachedTypes[i];
+			}
+		} else {
+			for (size_t i = 0; i < uncached.size(); ++i) {
+				if (!classified[i]) {
+					types[uncached[i]] = classifyWithExpectation(uncachedKmers[i], counts[i], biases[i], expectations[i]);
+				}
+			}
+		}
+	}
+
+	for (size_t i = 0; i < uncached.size(); ++i) {
+		cachedClassifications.insert(uncachedKmers[i], types[uncached[i]]);
+	}
+	return types;
+}
+
+// The same as classifyKmers on the unpacked k-mers, which all have size k. K-mers found in the reference table, the
+// class table or the cache are classified without unpacking them, so a batch of known k-mers allocates no memory if
+// types has room for it.
+void KmerClassificationUnit::classifyKmers(const std::vector<uint64_t> &packedKmers, size_t k,
+		std::vector<KmerType> &types) {
+	types.resize(packedKmers.size());
+	bool useReferenceTable = referenceTable && referenceTable->coversKmerSize(k);
+	bool useClassTable = classTable && classTable->getKmerSize() == k;
+	std::vector<size_t> unresolved;
+	std::vector<std::string> kmers;
+	for (size_t i = 0; i < packedKmers.size(); ++i) {
+		if (useReferenceTable) {
+			types[i] = classifyGenomeCount(referenceTable->multiplicity(packedKmers[i], k));
+		} else if ((!useClassTable || !classTable->lookup(packedKmers[i], types[i]))
+				&& !cachedClassifications.lookup(packedKmers[i], k, types[i])) {
+			unresolved.push_back(i);
+			kmers.push_back(unpackKmer(packedKmers[i], k));
+		}
+	}
+	if (unresolved.empty()) {
+		return;
+	}
+	std::vector<KmerType> unresolvedTypes = classifyKmers(kmers);
+	for (size_t i = 0; i < unresolved.size(); ++i) {
+		types[unresolved[i]] = unresolvedTypes[i];
+	}
+}
+
 double KmerClassificationUnit::kmerZScore(const std::string &kmer) {
 	// check if the k-mer is invalid
 	if (kmer.find("_") != std::string::npos) {
 		throw std::runtime_error("K-mer Z-score called with an invalid k-mer!");
 	}
-	double bias = biasUnit.getBias(kmer);
-	size_t observedCount = counter.countKmer(kmer);
-	double observedCountBiasCorrected = (1 / bias) * observedCount;
-	std::pair<double, double> expected = pusm.expectedCount(kmer);
-	double z = (((double) observedCountBiasCorrected) - expected.first) / expected.second;
-	if (z != z) {
-		throw std::runtime_error(
-				"the z-score is not a number!!! observedCount: " + std::to_string(observedCount) + ", bias: "
-						+ std::to_string(bias) + ", observedCountBiasCorrected: "
-						+ std::to_string(observedCountBiasCorrected) + ", expected.first: "
-						+ std::to_string(expected.first) + ", expected.second: " + std::to_string(expected.second));
+	return kmerZScoreCounted(kmer, counter.countKmer(kmer));
+}
+
+double KmerClassificationUnit::kmerZScore(const KmerCursor &cursor) {
+	// check if the k-mer is invalid
+	if (cursor.kmer().find("_") != std::string::npos) {
+		throw std::runtime_error("K-mer Z-score called with an invalid k-mer!");
 	}
-	return z;
+	if (classificationType == KmerClassificationType::CLASSIFICATION_CHEATING) { // the cursor counts in the reference
+		return kmerZScoreCounted(cursor.kmer(), counter.countKmer(cursor.kmer()));
+	}
+	return kmerZScoreCounted(cursor.kmer(), cursor.count());
+}
+
+double KmerClassificationUnit::kmerZScoreCounted(const std::string &kmer, size_t observedCount) {
+	return zScoreFromExpectation(observedCount, biasUnit.getBias(kmer), pusm.expectedCount(kmer));
 }
 
 size_t KmerClassificationUnit::getMinKmerSize() {
 	return biasUnit.getMinKmerSize();
 }
 
+// Only the Python classifier must not be called by several threads at once.
+bool KmerClassificationUnit::supportsConcurrentClassification() const {
+	return classificationType != KmerClassificationType::CLASSIFICATION_MACHINE_LEARNING || nativeClassifier.isLoaded();
+}
+
 KmerClassificationUnit::~KmerClassificationUnit() {
 	if (mlClassifier != NULL) {
 		Py_DECREF(mlClassifier);
 	}
 }
 
+// Has to be called whenever the classes may change, i.e. when the coverage bias or the classifier is replaced.
+// This also drops the count thresholds, which have to be compiled again afterwards.
 void KmerClassificationUnit::clearCache() {
 	cachedClassifications.clear();
+	thresholdCells.reset();
+	maxThresholdKmerSize = 0;
+	classTable.reset();
+}
+
+// true if the class table is enabled and contains the k-mer
+bool KmerClassificationUnit::lookupClassTable(const std::string &kmer, KmerType &type) const {
+	uint64_t packed;
+	if (!classTable || kmer.size() != classTable->getKmerSize() || !packKmer(kmer, packed)) {
+		return false;
+	}
+	return classTable->lookup(packed, type);
+}
+
+// true if the k-mer is classified by the reference table of CLASSIFICATION_CHEATING
+bool KmerClassificationUnit::lookupReferenceTable(const std::string &kmer, KmerType &type) const {
+	uint64_t packed;
+	if (!referenceTable || !referenceTable->coversKmerSize(kmer.size()) || !packKmer(kmer, packed)) {
+		return false;
+	}
+	type = classifyGenomeCount(referenceTable->multiplicity(packed, kmer.size()));
+	return true;
+}
+
+// From now on, CLASSIFICATION_CHEATING classifies k-mers of the given sizes by a lookup of their multiplicity in the
+// reference genome instead of counting them in its FM index. K-mers spanning line breaks of the reference file, which
+// the FM index of the file does not contain, are counted as well.
+void KmerClassificationUnit::enableReferenceTable(const seqan::Dna5String &referenceGenome,
+		const std::vector<size_t> &kmerSizes) {
+	if (classificationType != KmerClassificationType::CLASSIFICATION_CHEATING) {
+		return;
+	}
+	std::vector<size_t> coveredSizes;
+	for (size_t k : kmerSizes) {
+		if (k > 0 && k <= MAX_PACKED_KMER_SIZE) {
+			coveredSizes.push_back(k);
+		}
+	}
+	std::string genome(length(referenceGenome), 'N');
+	for (size_t i = 0; i < genome.size(); ++i) {
+		genome[i] = referenceGenome[i];
+	}
+	std::unique_ptr<ReferenceKmerTable> table(new ReferenceKmerTable(coveredSizes));
+	table->build(genome);
+	std::cout << "Reference k-mer table construction complete, table requires " << table->sizeInMegaBytes()
+			<< " MiB.\n";
+	referenceTable.swap(table);
+}
+
+static void hashBytes(uint64_t &hash, const void *data, size_t size) {
+	const unsigned char *bytes = (const unsigned char*) data;
+	for (size_t i = 0; i < size; ++i) { // FNV-1a
+		hash ^= bytes[i];
+		hash *= 0x100000001b3ULL;
+	}
+}
+
+// Hashes everything the class of a k-mer of size k depends on apart from its count: the classification type, the
+// coverage bias of every GC count, the PUSM expectation and, for CLASSIFICATION_MACHINE_LEARNING, the model.
+uint64_t KmerClassificationUnit::configurationHash(size_t k) {
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	uint32_t type = classificationType;
+	hashBytes(hash, &type, sizeof(type));
+	hashBytes(hash, &k, sizeof(k));
+	for (size_t numGC = 0; numGC <= k; ++numGC) {
+		double bias = biasUnit.getBias(std::string(numGC, 'G') + std::string(k - numGC, 'A'));
+		hashBytes(hash, &bias, sizeof(bias));
+	}
+	std::pair<double, double> expected = pusm.expectedCount(std::string(k, 'A'));
+	hashBytes(hash, &expected.first, sizeof(expected.first));
+	hashBytes(hash, &expected.second, sizeof(expected.second));
+	if (classificationType == KmerClassificationType::CLASSIFICATION_MACHINE_LEARNING) {
+		std::ifstream model(nativeModelFile);
+		std::string line;
+		while (std::getline(model, line)) {
+			hashBytes(hash, line.data(), line.size());
+		}
+	}
+	return hash;
+}
+
+// Classifies every distinct k-mer of the fixed k-mer size of the reads counter once, and stores the classes next to
+// its FM index, or maps the classes a previous run with the same configuration has stored. Has to be called once the
+// coverage bias and the classifier are final, and again after clearCache(). Without a fixed-size table in the reads
+// counter, or if the classes cannot be computed on several threads, it does nothing.
+void KmerClassificationUnit::enableClassTable() {
+	classTable.reset();
+	const KmerCountTable *countTable = counter.getFixedSizeTable();
+	if (!countTable || classificationType == KmerClassificationType::CLASSIFICATION_CHEATING
+			|| (classificationType == KmerClassificationType::CLASSIFICATION_MACHINE_LEARNING
+					&& !nativeClassifier.isLoaded())) {
+		return;
+	}
+	size_t k = countTable->getKmerSize();
+	uint64_t hash = configurationHash(k); // also puts the PUSM expectation of size k into its buffer
+	std::ostringstream tableFile;
+	tableFile << counter.getTextFile() << ".k" << k << "." << std::hex << hash << ".kcl";
+	TextFileStamp textFileStamp = stampOfFile(counter.getTextFile());
+
+	std::unique_ptr<KmerClassTable> table(new KmerClassTable(*countTable, hash));
+	if (!table->loadTable(tableFile.str(), textFileStamp)) {
+		std::cout << "Classifying all " << countTable->getNumDistinctKmers() << " distinct " << k
+				<< "-mers of the reads...\n";
+		table->build([this](const std::string &kmer, size_t count) {
+			return classifyCountedUncached(kmer, count);
+		});
+		table->storeTable(tableFile.str(), textFileStamp);
+		table->loadTable(tableFile.str(), textFileStamp);
+		std::cout << "K-mer class table construction complete, table requires " << table->sizeInMegaBytes()
+				<< " MiB.\n";
+	}
+	classTable.swap(table);
+}
+
+// Builds the de Bruijn graph of the k-mers of the minimum size in the reads that are not untrusted, after the class
+// table, which most of them are looked up in.
+void KmerClassificationUnit::enableSolidKmerGraph() {
+	solidGraph.reset();
+	const KmerCountTable *countTable = counter.getFixedSizeTable();
+	if (!countTable) {
+		return;
+	}
+	size_t k = countTable->getKmerSize();
+	std::cout << "Building the de Bruijn graph of the solid " << k << "-mers of the reads...\n";
+	std::unique_ptr<SolidKmerGraph> graph(new SolidKmerGraph(*countTable));
+	graph->build([this, k](uint64_t canonical, size_t count) {
+		std::string kmer = unpackKmer(canonical, k);
+		KmerType type;
+		if (!lookupReferenceTable(kmer, type) && !lookupClassTable(kmer, type)) {
+			if (classificationType == KmerClassificationType::CLASSIFICATION_CHEATING) {
+				type = classifyGenomeCount(genomeCounter.countKmer(kmer));
+			} else {
+				type = classifyCountedUncached(kmer, count);
+			}
+		}
+		return type != KmerType::UNTRUSTED;
+	}, supportsConcurrentClassification());
+	std::cout << "De Bruijn graph construction complete, " << graph->getNumNodes() << " solid k-mers, graph requires "
+			<< graph->sizeInMegaBytes() << " MiB.\n";
+	solidGraph.swap(graph);
+}
+
+// NULL if the graph is not enabled
+const SolidKmerGraph* KmerClassificationUnit::getSolidKmerGraph() const {
+	return solidGraph.get();
+}
+
+// Compiles the thresholds of the k-mer size and GC count on first use. While another thread compiles them, and if they
+// cannot be compiled, the k-mers are left to the floating-point classification, which classifies them the same way.
+bool KmerClassificationUnit::thresholdsOf(size_t k, size_t numGC, CountThresholds &thresholds) {
+	if (k == 0 || k > maxThresholdKmerSize) {
+		return false;
+	}
+	ThresholdCell &cell = thresholdCells[k * (k + 1) / 2 + numGC];
+	uint8_t state = cell.state.load(std::memory_order_acquire);
+	if (state == THRESHOLDS_PENDING && cell.state.compare_exchange_strong(state, THRESHOLDS_COMPILING)) {
+		bool compiled = compileThresholdCell(k, numGC, thresholds);
+		cell.minTrusted = thresholds.minTrusted;
+		cell.minRepeat = thresholds.minRepeat;
+		state = compiled ? THRESHOLDS_COMPILED : THRESHOLDS_FLOATING_POINT;
+		cell.state.store(state, std::memory_order_release);
+	}
+	if (state != THRESHOLDS_COMPILED) {
+		return false;
+	}
+	thresholds.minTrusted = cell.minTrusted;
+	thresholds.minRepeat = cell.minRepeat;
+	thresholds.compiled = true;
+	return true;
+}
+
+KmerType KmerClassificationUnit::classifyByThresholds(const CountThresholds &thresholds, size_t observedCount) {
+	if (observedCount < thresholds.minTrusted) {
+		return KmerType::UNTRUSTED;
+	} else if (observedCount < thresholds.minRepeat) {
+		return KmerType::TRUSTED;
+	} else {
+		return KmerType::REPEAT;
+	}
+}
+
+// the floating-point classification of any k-mer with k bases, numGC of which are G or C
+KmerType KmerClassificationUnit::classifyRepresentative(size_t k, size_t numGC, size_t observedCount) {
+	std::string kmer = std::string(numGC, 'G') + std::string(k - numGC, 'A');
+	return classifyWithExpectation(kmer, observedCount, biasUnit.getBias(kmer), pusm.expectedCount(kmer));
+}
+
+// From now on, the statistical or naive classification of k-mers of up to maxKmerSize bases is compiled into count
+// thresholds, one k-mer size and GC count at a time, when the first k-mer of that size and GC count is classified.
+// Has to be called after the coverage bias has been learned, and again after clearCache().
+void KmerClassificationUnit::compileThresholds(size_t maxKmerSize) {
+	thresholdCells.reset();
+	maxThresholdKmerSize = 0;
+	if (classificationType != KmerClassificationType::CLASSIFICATION_STATISTICAL
+			&& classificationType != KmerClassificationType::CLASSIFICATION_NAIVE) {
+		return;
+	}
+	size_t numCells = (maxKmerSize + 1) * (maxKmerSize + 2) / 2;
+	thresholdCells.reset(new ThresholdCell[numCells]);
+	for (size_t i = 0; i < numCells; ++i) {
+		thresholdCells[i].state.store(THRESHOLDS_PENDING, std::memory_order_relaxed);
+	}
+	maxThresholdKmerSize = maxKmerSize;
+}
+
+// The thresholds are searched with the floating-point classification itself and checked against it. Returns false if
+// they disagree, or if it throws for some count (the z-score is not a number), so that the k-mer size and GC count is
+// left to the floating-point path.
+bool KmerClassificationUnit::compileThresholdCell(size_t k, size_t numGC, CountThresholds &thresholds) {
+	static const size_t MAX_THRESHOLD = (size_t) 1 << 40;
+	thresholds.minTrusted = 0;
+	thresholds.minRepeat = 0;
+	thresholds.compiled = false;
+	try {
+		// the smallest power of two that is repetitive bounds both thresholds
+		size_t upper = 1;
+		while (upper < MAX_THRESHOLD && classifyRepresentative(k, numGC, upper) != KmerType::REPEAT) {
+			upper *= 2;
+		}
+		if (upper >= MAX_THRESHOLD) {
+			return false;
+		}
+		size_t lo = 0;
+		size_t hi = upper;
+		while (lo < hi) { // smallest count that is not untrusted
+			size_t mid = lo + (hi - lo) / 2;
+			if (classifyRepresentative(k, numGC, mid) == KmerType::UNTRUSTED) {
+				lo = mid + 1;
+			} else {
+				hi = mid;
+			}
+		}
+		thresholds.minTrusted = lo;
+		hi = upper;
+		while (lo < hi) { // smallest count that is repetitive
+			size_t mid = lo + (hi - lo) / 2;
+			if (classifyRepresentative(k, numGC, mid) != KmerType::REPEAT) {
+				lo = mid + 1;
+			} else {
+				hi = mid;
+			}
+		}
+		thresholds.minRepeat = lo;
+		thresholds.compiled = thresholdsAgree(k, numGC, thresholds);
+	} catch (std::runtime_error &e) {
+		thresholds.compiled = false;
+	}
+	return thresholds.compiled;
+}
+
+// Checks that the thresholds classify every count up to a bit beyond the repeat threshold, and a few larger counts,
+// exactly like the floating-point classification. Throws if the floating-point classification does.
+bool KmerClassificationUnit::thresholdsAgree(size_t k, size_t numGC, const CountThresholds &thresholds) {
+	static const size_t MAX_CHECKED_COUNTS = 4096;
+	std::vector<size_t> checkedCounts;
+	for (size_t count = 0; count <= std::min(thresholds.minRepeat + 64, MAX_CHECKED_COUNTS); ++count) {
+		checkedCounts.push_back(count);
+	}
+	for (size_t count : { thresholds.minTrusted, thresholds.minRepeat, 2 * thresholds.minRepeat, 1000
+			* thresholds.minRepeat }) {
+		checkedCounts.push_back(count);
+	}
+	if (thresholds.minTrusted > 0) {
+		checkedCounts.push_back(thresholds.minTrusted - 1);
+	}
+	if (thresholds.minRepeat > 0) {
+		checkedCounts.push_back(thresholds.minRepeat - 1);
+	}
+	for (size_t count : checkedCounts) {
+		if (classifyByThresholds(thresholds, count) != classifyRepresentative(k, numGC, count)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// True if all thresholds compiled so far still agree exactly with the floating-point classification. This repeats the
+// check every compilation makes, so it is only run by builds with -DPAEC_VERIFY_THRESHOLDS.
+bool KmerClassificationUnit::verifyThresholds() {
+	for (size_t k = 1; k <= maxThresholdKmerSize; ++k) {
+		for (size_t numGC = 0; numGC <= k; ++numGC) {
+			const ThresholdCell &cell = thresholdCells[k * (k + 1) / 2 + numGC];
+			if (cell.state.load(std::memory_order_acquire) != THRESHOLDS_COMPILED) {
+				continue;
+			}
+			CountThresholds thresholds = { cell.minTrusted, cell.minRepeat, true };
+			try {
+				if (!thresholdsAgree(k, numGC, thresholds)) {
+					std::cout << "Count thresholds disagree for k = " << k << ", #GC = " << numGC << "\n";
+					return false;
+				}
+			} catch (std::runtime_error &e) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+KmerClassificationCache& KmerClassificationUnit::getCache() {
+	return cachedClassifications;
 }
@@ -9,13 +9,22 @@
 
 #include <seqan/sequence.h>
 #include <stddef.h>
+#include <atomic>
+#include <cstdint>
 #include <iostream>
 #include <memory>
 #include <string>
+#include <utility>
+#include <vector>
 #include <python2.7/Python.h>
 
 #include "../AlignedInformation/Dataset.hpp"
 #include "KmerType.h"
+#include "KmerClassificationCache.h"
+#include "KmerClassTable.h"
+#include "ReferenceKmerTable.h"
+#include "SolidKmerGraph.h"
+#include "NativeKmerClassifier.h"
 
 #include "../CoverageBias/CoverageBiasUnit.h"
 #include "KmerCounter.h"
@@ -25,34 +34,108 @@ enum KmerClassificationType {
 	CLASSIFICATION_STATISTICAL = 0, CLASSIFICATION_NAIVE = 1, CLASSIFICATION_MACHINE_LEARNING = 2, CLASSIFICATION_CHEATING = 3
 };
 
+// one base a growing k-mer is extended by, at its left or at its right end
+struct KmerExtension {
+	char base;
+	bool left;
+};
+
 class KmerClassificationUnit {
 public:
 	KmerClassificationUnit(KmerCounter &kmerCounter, KmerCounter &refCounter, CoverageBiasUnit &biasUnitRef,
 			PerfectUniformSequencingModel &pusmRef, KmerClassificationType type);
 	~KmerClassificationUnit();
 	void trainClassifier(Dataset &ds, KmerCounter &genomeCounter);
+	KmerCursor startCursor(const std::string &kmer);
 	KmerType classifyKmer(const std::string &kmer);
+	KmerType classifyKmer(const KmerCursor &cursor);
+	KmerType classifyGrowingKmer(KmerCursor &cursor, const std::vector<KmerExtension> &extensions,
+			const std::vector<size_t> &checkpoints, size_t &numExtended);
+	std::vector<KmerType> classifyKmers(const std::vector<std::string> &kmers);
+	void classifyKmers(const std::vector<uint64_t> &packedKmers, size_t k, std::vector<KmerType> &types);
 	KmerType classifyZScore(double zScore);
 	double kmerZScore(const std::string &kmer);
+	double kmerZScore(const KmerCursor &cursor);
 	size_t getMinKmerSize();
+	bool supportsConcurrentClassification() const;
 	void storeClassifier(const std::string &filename);
 	void loadClassifier(const std::string &filename);
 	void clearCache();
+	KmerClassificationCache& getCache();
+	void compileThresholds(size_t maxKmerSize);
+	bool verifyThresholds();
+	void enableClassTable();
+	void enableReferenceTable(const seqan::Dna5String &referenceGenome, const std::vector<size_t> &kmerSizes);
+	void enableSolidKmerGraph();
+	const SolidKmerGraph* getSolidKmerGraph() const;
 private:
+	// The statistical and the naive classification of a k-mer only depend on its size, its number of G and C and its
+	// count, and are monotonic in the count: counts below minTrusted are untrusted, counts from minRepeat on are
+	// repetitive. If compiled is false, the k-mers are classified by their z-score or bias-corrected count.
+	struct CountThresholds {
+		size_t minTrusted;
+		size_t minRepeat;
+		bool compiled;
+	};
+	// the thresholds of one k-mer size and GC count, compiled by the first thread that needs them
+	enum ThresholdState : uint8_t {
+		THRESHOLDS_PENDING = 0, THRESHOLDS_COMPILING = 1, THRESHOLDS_COMPILED = 2, THRESHOLDS_FLOATING_POINT = 3
+	};
+	struct ThresholdCell {
+		std::atomic<uint8_t> state;
+		size_t minTrusted; // only valid once state is THRESHOLDS_COMPILED
+		size_t minRepeat;
+	};
+	bool thresholdsOf(size_t k, size_t numGC, CountThresholds &thresholds);
+	bool compileThresholdCell(size_t k, size_t numGC, CountThresholds &thresholds);
+	static KmerType classifyByThresholds(const CountThresholds &thresholds, size_t observedCount);
+	KmerType classifyRepresentative(size_t k, size_t numGC, size_t observedCount);
+	bool thresholdsAgree(size_t k, size_t numGC, const CountThresholds &thresholds);
+
+	// one row of the k-mer training data, in the order of the features followed by the class id
+	struct TrainingSample {
+		double zScore;
+		double gcContent;
+		double size;
+		double observedCount;
+		double biasCorrectedObservedCount;
+		double expectedCountPusm;
+		double type;
+	};
 	void extractTrainingData(Dataset &ds, size_t k, std::ofstream &outfile);
 	void extractTrainingDataFromReference(const seqan::Dna5String &referenceGenome, size_t k,
-			KmerCounter &referenceCounter, std::ofstream &outfile);
-	void writeTrainingString(double zScore, double gc, size_t k, double countObserved, double countBiasCorrected,
-			double countExpectedPusm, KmerType type, std::ofstream &outfile);
+			KmerCounter &referenceCounter, uint64_t seed, std::vector<TrainingSample> &samples);
+	void appendTrainingSamples(const std::vector<std::string> &kmers, const std::vector<size_t> &observedCounts,
+			KmerCounter &referenceCounter, std::vector<TrainingSample> &samples);
+	static void writeTrainingData(const std::string &filename, const std::vector<TrainingSample> &samples);
+	KmerType classifyCounted(const std::string &kmer, size_t observedCount);
+	KmerType classifyCountedUncached(const std::string &kmer, size_t observedCount);
+	KmerType classifyWithExpectation(const std::string &kmer, size_t observedCount, double bias,
+			const std::pair<double, double> &expected);
+	void classifyMachineLearningBatch(const std::vector<std::vector<double> > &featureRows, std::vector<KmerType> &types);
+	std::vector<double> machineLearningFeatures(const std::string &kmer, size_t observedCount, double bias,
+			const std::pair<double, double> &expected);
+	double kmerZScoreCounted(const std::string &kmer, size_t observedCount);
+	void exportNativeClassifier(const std::string &modelFile);
+	bool lookupClassTable(const std::string &kmer, KmerType &type) const;
+	bool lookupReferenceTable(const std::string &kmer, KmerType &type) const;
+	uint64_t configurationHash(size_t k);
 	KmerCounter &counter;
 	KmerCounter &genomeCounter;
 	CoverageBiasUnit &biasUnit;
 	PerfectUniformSequencingModel &pusm;
 	KmerClassificationType classificationType;
-	std::string featureNames;
 	std::string outputPath;
 
-	std::unordered_map<std::string, KmerType> cachedClassifications;
+	KmerClassificationCache cachedClassifications;
+	// row k holds the k + 1 cells of k-mer size k, by number of G and C, for k up to maxThresholdKmerSize
+	std::unique_ptr<ThresholdCell[]> thresholdCells;
+	size_t maxThresholdKmerSize;
 
 	PyObject* mlClassifier;
+	NativeKmerClassifier nativeClassifier;
+	std::string nativeModelFile; // the file the native classifier has been loaded from
+	std::unique_ptr<KmerClassTable> classTable; // classes of the k-mers of the minimum size in the reads, if enabled
+	std::unique_ptr<ReferenceKmerTable> referenceTable; // reference multiplicities for CLASSIFICATION_CHEATING, if enabled
+	std::unique_ptr<SolidKmerGraph> solidGraph; // de Bruijn graph of the solid k-mers of the minimum size, if enabled
 };
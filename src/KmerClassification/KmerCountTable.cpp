@@ -0,0 +1,225 @@
+/*
+ * KmerCountTable.cpp
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: sarah
+ */
+
+#include "KmerCountTable.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+#include "PackedKmer.h"
+#include "../SequenceLineReader.h"
+
+// written in front of a stored table
+static const char TABLE_MAGIC[8] = { 'P', 'A', 'E', 'C', 'K', 'C', 'T', '2' };
+// packed k-mers use at most 62 bits, so this never is a valid key
+static const uint64_t EMPTY_KEY = ~0ULL;
+// number of lines that are read from the file before they are counted in parallel
+static const size_t LINES_PER_CHUNK = 100000;
+
+KmerCountTable::KmerCountTable(size_t k) {
+	if (k == 0 || k > MAX_PACKED_KMER_SIZE) {
+		throw std::runtime_error("K-mer count tables only support k-mer sizes from 1 to 31!");
+	}
+	this->k = k;
+	numKeys = 0;
+	slotMask = 0;
+	keys.assign(1, EMPTY_KEY);
+	counts.assign(1, 0);
+}
+
+size_t KmerCountTable::getKmerSize() const {
+	return k;
+}
+
+size_t KmerCountTable::getNumDistinctKmers() const {
+	return numKeys;
+}
+
+double KmerCountTable::sizeInMegaBytes() const {
+	return (keys.size() * sizeof(uint64_t) + counts.size() * sizeof(uint32_t)) / (1024.0 * 1024.0);
+}
+
+// Grows the table such that numKeysNeeded keys stay below a load factor of 0.7. Not thread-safe.
+void KmerCountTable::reserve(size_t numKeysNeeded) {
+	size_t capacity = keys.size();
+	while (numKeysNeeded > 0.7 * capacity) {
+		capacity *= 2;
+	}
+	if (capacity == keys.size()) {
+		return;
+	}
+	std::vector<uint64_t> oldKeys(capacity, EMPTY_KEY);
+	std::vector<uint32_t> oldCounts(capacity, 0);
+	oldKeys.swap(keys);
+	oldCounts.swap(counts);
+	slotMask = capacity - 1;
+	for (size_t i = 0; i < oldKeys.size(); ++i) {
+		if (oldKeys[i] != EMPTY_KEY) {
+			size_t slot = hashPacked(oldKeys[i]) & slotMask;
+			while (keys[slot] != EMPTY_KEY) {
+				slot = (slot + 1) & slotMask;
+			}
+			keys[slot] = oldKeys[i];
+			counts[slot] = oldCounts[i];
+		}
+	}
+}
+
+// Thread-safe, as long as the table has been reserved for all keys that are inserted concurrently.
+void KmerCountTable::insertCanonical(uint64_t canonical) {
+	size_t slot = hashPacked(canonical) & slotMask;
+	while (true) {
+		uint64_t key = __atomic_load_n(&keys[slot], __ATOMIC_RELAXED);
+		if (key == EMPTY_KEY) {
+			if (__atomic_compare_exchange_n(&keys[slot], &key, canonical, false, __ATOMIC_RELAXED,
+					__ATOMIC_RELAXED)) {
+				__atomic_fetch_add(&numKeys, 1, __ATOMIC_RELAXED);
+				key = canonical;
+			} // otherwise key now holds the k-mer another thread has put there
+		}
+		if (key == canonical) {
+			__atomic_fetch_add(&counts[slot], 1, __ATOMIC_RELAXED);
+			return;
+		}
+		slot = (slot + 1) & slotMask;
+	}
+}
+
+// Counts all windows of size k that consist of A, C, G and T only, by their canonical k-mer.
+void KmerCountTable::countLine(const std::string &line) {
+	if (!line.empty() && line[0] == '>') {
+		return;
+	}
+	uint64_t mask = packedKmerMask(k);
+	size_t shift = 2 * (k - 1);
+	uint64_t fwd = 0;
+	uint64_t rc = 0;
+	size_t numValid = 0;
+	for (size_t i = 0; i < line.size(); ++i) {
+		uint64_t code = packBase(line[i]);
+		if (code > 3) {
+			numValid = 0;
+			continue;
+		}
+		fwd = ((fwd << 2) | code) & mask;
+		rc = (rc >> 2) | ((3 - code) << shift);
+		numValid++;
+		if (numValid >= k) {
+			insertCanonical(std::min(fwd, rc));
+		}
+	}
+}
+
+void KmerCountTable::buildFromFile(const std::string &filepath) {
+	SequenceLineReader reader(filepath);
+	std::vector<std::string> lines;
+	lines.reserve(LINES_PER_CHUNK);
+	std::string line;
+	bool linesLeft = true;
+	while (linesLeft) {
+		lines.clear();
+		size_t numWindows = 0;
+		while (lines.size() < LINES_PER_CHUNK && reader.nextLine(line)) {
+			if (line.size() >= k) {
+				numWindows += line.size() - k + 1;
+			}
+			lines.push_back(line);
+		}
+		linesLeft = (lines.size() == LINES_PER_CHUNK);
+
+		// every window of the chunk could be a new k-mer, so the table never fills up while the chunk is counted
+		reserve(numKeys + numWindows);
+#pragma omp parallel for schedule(dynamic, 64)
+		for (size_t i = 0; i < lines.size(); ++i) {
+			countLine(lines[i]);
+		}
+	}
+}
+
+size_t KmerCountTable::findSlot(uint64_t canonical) const {
+	size_t slot = hashPacked(canonical) & slotMask;
+	while (keys[slot] != EMPTY_KEY && keys[slot] != canonical) {
+		slot = (slot + 1) & slotMask;
+	}
+	return slot;
+}
+
+// The slots let other tables store a value per distinct k-mer without keys of their own.
+size_t KmerCountTable::getNumSlots() const {
+	return keys.size();
+}
+
+// false if the slot is empty
+bool KmerCountTable::kmerInSlot(size_t slot, uint64_t &canonical) const {
+	canonical = keys[slot];
+	return canonical != EMPTY_KEY;
+}
+
+// the slot of the canonical k-mer of packedKmer, false if it does not occur
+bool KmerCountTable::findKmer(uint64_t packedKmer, size_t &slot) const {
+	slot = findSlot(canonicalPacked(packedKmer, k));
+	return keys[slot] != EMPTY_KEY;
+}
+
+size_t KmerCountTable::countKmer(uint64_t packedKmer) const {
+	uint64_t rc = reverseComplementPacked(packedKmer, k);
+	size_t slot = findSlot(std::min(packedKmer, rc));
+	size_t count = (keys[slot] == EMPTY_KEY) ? 0 : counts[slot];
+	if (rc == packedKmer) { // a palindromic k-mer is counted once per occurrence on each of the two strands
+		count *= 2;
+	}
+	return count;
+}
+
+bool KmerCountTable::loadTable(const std::string &tableFile, const TextFileStamp &textFileStamp) {
+	std::ifstream infile(tableFile, std::ios::binary);
+	if (!infile.good()) {
+		return false;
+	}
+	char magic[sizeof(TABLE_MAGIC)];
+	uint32_t storedK;
+	TextFileStamp storedStamp;
+	uint64_t capacity, storedNumKeys;
+	infile.read(magic, sizeof(magic));
+	infile.read((char*) &storedK, sizeof(storedK));
+	infile.read((char*) &storedStamp, sizeof(storedStamp));
+	infile.read((char*) &capacity, sizeof(capacity));
+	infile.read((char*) &storedNumKeys, sizeof(storedNumKeys));
+	if (!infile.good() || !std::equal(magic, magic + sizeof(magic), TABLE_MAGIC) || storedK != k
+			|| storedStamp != textFileStamp || capacity == 0 || (capacity & (capacity - 1)) != 0) {
+		return false;
+	}
+	keys.resize(capacity);
+	counts.resize(capacity);
+	infile.read((char*) keys.data(), capacity * sizeof(uint64_t));
+	infile.read((char*) counts.data(), capacity * sizeof(uint32_t));
+	if (!infile.good()) {
+		return false;
+	}
+	numKeys = storedNumKeys;
+	slotMask = capacity - 1;
+	return true;
+}
+
+// The table is written to a temporary file first, so that a table other processes are reading is never overwritten.
+void KmerCountTable::storeTable(const std::string &tableFile, const TextFileStamp &textFileStamp) {
+	DerivedFileWriter writer(tableFile);
+	std::ofstream &outfile = writer.stream();
+	uint32_t storedK = k;
+	uint64_t capacity = keys.size();
+	uint64_t storedNumKeys = numKeys;
+	outfile.write(TABLE_MAGIC, sizeof(TABLE_MAGIC));
+	outfile.write((const char*) &storedK, sizeof(storedK));
+	outfile.write((const char*) &textFileStamp, sizeof(textFileStamp));
+	outfile.write((const char*) &capacity, sizeof(capacity));
+	outfile.write((const char*) &storedNumKeys, sizeof(storedNumKeys));
+	outfile.write((const char*) keys.data(), capacity * sizeof(uint64_t));
+	outfile.write((const char*) counts.data(), capacity * sizeof(uint32_t));
+	writer.commit();
+}
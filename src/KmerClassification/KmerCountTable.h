@@ -0,0 +1,46 @@
+/*
+ * KmerCountTable.h
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: sarah
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../DerivedFile.h"
+
+/*
+ * Exact counts of all canonical k-mers of a single size k, stored in an open addressing hash table with 2-bit packed keys.
+ * It is built in one pass over the same file the FM index is built from (one sequence per line, or FASTQ), and returns the
+ * same counts as KmerCounter::countKmer for k-mers consisting of A, C, G and T only.
+ */
+class KmerCountTable {
+public:
+	KmerCountTable(size_t k);
+	void buildFromFile(const std::string &filepath);
+	bool loadTable(const std::string &tableFile, const TextFileStamp &textFileStamp);
+	void storeTable(const std::string &tableFile, const TextFileStamp &textFileStamp);
+	size_t countKmer(uint64_t packedKmer) const;
+	size_t getKmerSize() const;
+	size_t getNumDistinctKmers() const;
+	size_t getNumSlots() const;
+	bool kmerInSlot(size_t slot, uint64_t &canonical) const;
+	bool findKmer(uint64_t packedKmer, size_t &slot) const;
+	double sizeInMegaBytes() const;
+private:
+	void countLine(const std::string &line);
+	void insertCanonical(uint64_t canonical);
+	void reserve(size_t numKeysNeeded);
+	size_t findSlot(uint64_t canonical) const;
+
+	size_t k;
+	size_t numKeys;
+	uint64_t slotMask;
+	std::vector<uint64_t> keys;
+	std::vector<uint32_t> counts;
+};
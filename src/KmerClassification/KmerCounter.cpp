@@ -6,43 +6,394 @@
  */
 
 #include "KmerCounter.h"
+#include "PackedKmer.h"
+#include "../SequenceLineReader.h"
 
 #include <stdexcept>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
 #include <fstream>
 
+// written in front of the serialized FM index; files without it are legacy forward-only indexes
+static const char INDEX_MAGIC[8] = { 'P', 'A', 'E', 'C', 'F', 'M', '9', '\0' };
+
+static uint64_t fileSize(const std::string &filepath) {
+	std::ifstream infile(filepath, std::ios::binary | std::ios::ate);
+	return infile.tellg();
+}
+
 void KmerCounter::changeFile(const std::string &filepath) {
 	clearBuffers();
+	loadOrConstructIndex(filepath);
+	if (fixedSizeTable) {
+		loadOrConstructFixedSizeTable(fixedSizeTable->getKmerSize());
+	}
+	if (prefilter) {
+		loadOrConstructPrefilter(prefilter->getKmerSizes());
+	}
+}
+
+KmerCounter::KmerCounter(const std::string &filepath, IndexStrandMode mode, FMIndexType type,
+		const IndexConstructionOptions &options) {
+	indexType = type;
+	constructionOptions = options;
+	for (PrefilterStatistics &statistics : prefilterStatistics) {
+		statistics.numQueries = 0;
+		statistics.numSkippedSearches = 0;
+	}
+	requestedMode = mode;
+	strandMode = mode;
+	loadOrConstructIndex(filepath);
+}
+
+void KmerCounter::loadOrConstructIndex(const std::string &filepath) {
 	std::ifstream infile(filepath);
 	if (!infile.good()) {
 		throw std::runtime_error("This file does not exist! " + filepath);
 	}
 
-	std::string index_suffix = ".fm9";
+	textFile = filepath;
+	std::string index_suffix = fmIndexFileSuffix(indexType);
 	std::string index_file = filepath + index_suffix;
-	if (!load_from_file(fm_index, index_file)) {
+	fm_index = createFMIndex(indexType);
+	// taken before the text is read, so that an index built while the text changes is stale afterwards
+	TextFileStamp textFileStamp = stampOfFile(filepath);
+	if (!loadIndex(index_file, textFileStamp)) {
 		std::cout << "No FM index found. Constructing FM index..." << std::endl;
-		construct(fm_index, filepath, 1); // generate index
-		store_to_file(fm_index, index_file); // save it
-		std::cout << "Index construction complete, index requires " << size_in_mega_bytes(fm_index) << " MiB."
+		strandMode = requestedMode;
+		constructIndex(filepath); // generate index
+		storeIndex(index_file, textFileStamp); // save it
+		std::cout << "Index construction complete, index requires " << fm_index->sizeInMegaBytes() << " MiB."
 				<< std::endl;
+	} else if (strandMode != requestedMode) {
+		std::cout << "Note: " << index_file << " was built with a different strand mode than requested. "
+				<< "Delete it to rebuild the index in the requested mode." << std::endl;
 	}
+	checkBidirectional();
 }
 
-KmerCounter::KmerCounter(const std::string &filepath) {
-	std::ifstream infile(filepath);
+// The twin interval of a cursor can only be derived from the index if the text is closed under reverse complement and
+// every symbol sorting after 'A' is a base, so that all other contexts of a k-mer sort in front of its extensions.
+void KmerCounter::checkBidirectional() {
+	bidirectional = (strandMode == IndexStrandMode::BOTH_STRANDS);
+	for (size_t i = 0; i < fm_index->sigma(); ++i) {
+		char c = fm_index->symbol(i);
+		if (c >= 'A' && c != 'A' && c != 'C' && c != 'G' && c != 'N' && c != 'T') {
+			bidirectional = false;
+		}
+	}
+}
+
+// The stamp of the text file an index has been built from is stored next to it, in indexFile + ".stamp". An index
+// without a stamp, like the ones of older versions, cannot be checked against its text file, so it counts as stale just
+// like one with a different stamp, and is built again.
+bool KmerCounter::loadIndex(const std::string &indexFile, const TextFileStamp &textFileStamp) {
+	std::ifstream infile(indexFile, std::ios::binary);
 	if (!infile.good()) {
-		throw std::runtime_error("This file does not exist! " + filepath);
+		return false;
+	}
+	std::ifstream stampFile(indexFile + ".stamp");
+	TextFileStamp storedStamp;
+	if (!(stampFile >> storedStamp.size >> storedStamp.mtimeNanos) || storedStamp != textFileStamp) {
+		std::cout << indexFile << " is stale, it may not belong to the current version of " << textFile << "."
+				<< std::endl;
+		return false;
+	}
+	char magic[sizeof(INDEX_MAGIC)];
+	infile.read(magic, sizeof(magic));
+	if (infile.good() && std::equal(magic, magic + sizeof(magic), INDEX_MAGIC)) {
+		uint32_t mode;
+		infile.read((char*) &mode, sizeof(mode));
+		strandMode = (mode == (uint32_t) IndexStrandMode::BOTH_STRANDS) ?
+				IndexStrandMode::BOTH_STRANDS : IndexStrandMode::FORWARD_ONLY;
+	} else {
+		// legacy index without header, it has been built over the forward strand only
+		infile.clear();
+		infile.seekg(0);
+		strandMode = IndexStrandMode::FORWARD_ONLY;
 	}
+	fm_index->load(infile);
+	return !infile.fail();
+}
 
-	std::string index_suffix = ".fm9";
-	std::string index_file = filepath + index_suffix;
-	if (!load_from_file(fm_index, index_file)) {
-		std::cout << "No FM index found. Constructing FM index..." << std::endl;
-		construct(fm_index, filepath, 1); // generate index
-		store_to_file(fm_index, index_file); // save it
-		std::cout << "Index construction complete, index requires " << size_in_mega_bytes(fm_index) << " MiB."
+// The index is written to a temporary file and renamed into place, so that storing an index while other processes
+// load it does not pull the file from under them. Its stamp follows once the index is complete.
+void KmerCounter::storeIndex(const std::string &indexFile, const TextFileStamp &textFileStamp) {
+	DerivedFileWriter writer(indexFile);
+	std::ofstream &outfile = writer.stream();
+	uint32_t mode = (uint32_t) strandMode;
+	outfile.write(INDEX_MAGIC, sizeof(INDEX_MAGIC));
+	outfile.write((const char*) &mode, sizeof(mode));
+	fm_index->serialize(outfile);
+	writer.commit();
+
+	DerivedFileWriter stampWriter(indexFile + ".stamp");
+	stampWriter.stream() << textFileStamp.size << " " << textFileStamp.mtimeNanos << "\n";
+	stampWriter.commit();
+}
+
+// Appends a line and a line break to the first size symbols of text, and grows it by half if they do not fit.
+static void appendLine(int_vector<8> &text, size_t &size, const std::string &line) {
+	if (size + line.size() + 1 > text.size()) {
+		text.resize(std::max(text.size() + text.size() / 2, size + line.size() + 1));
+	}
+	for (size_t i = 0; i < line.size(); ++i) {
+		text[size++] = (uint8_t) line[i];
+	}
+	text[size++] = '\n';
+}
+
+// Packs the sequence lines of a text or FASTQ file (possibly gzipped) into the text to be indexed, each followed by a
+// line break, in a single pass straight into the vector that is indexed. The vector starts with the size of the file,
+// or twice that for a plain text over both strands (the sequence lines of a FASTQ file and their reverse complements
+// fit into its size), which is enough for any uncompressed file, so it only grows for gzipped files. On an index over
+// both strands, every line is followed by its reverse complement, except for FASTA header lines. The read-length
+// histogram of a FASTQ file is collected in the same pass and stored next to it, so that the Dataset does not need to
+// read the reads again.
+void KmerCounter::packText(const std::string &filepath, int_vector<8> &text) {
+	SequenceLineReader reader(filepath);
+	std::unordered_map<size_t, size_t> readLengths;
+	size_t size = 0;
+	bool twoCopies = (strandMode == IndexStrandMode::BOTH_STRANDS && !reader.isFastq());
+	text.resize(std::max((uint64_t) 1, fileSize(filepath)) * (twoCopies ? 2 : 1));
+	std::string line;
+	while (reader.nextLine(line)) {
+		appendLine(text, size, line);
+		if (strandMode == IndexStrandMode::BOTH_STRANDS && !line.empty() && line[0] != '>') {
+			appendLine(text, size, reverseComplementString(line));
+		}
+		if (reader.isFastq() && !line.empty()) {
+			readLengths[line.size()]++;
+		}
+	}
+	text.resize(size);
+	if (reader.isFastq()) {
+		storeReadLengths(filepath, readLengths);
+	}
+}
+
+// Selects the suffix sorter of sdsl, which is a global setting, for as long as it exists, also if construction throws.
+class SuffixSorterChoice {
+public:
+	SuffixSorterChoice(byte_sa_algo_type algorithm) {
+		previous = construct_config::byte_algo_sa;
+		construct_config::byte_algo_sa = algorithm;
+	}
+	~SuffixSorterChoice() {
+		construct_config::byte_algo_sa = previous;
+	}
+	SuffixSorterChoice(const SuffixSorterChoice&) = delete;
+	SuffixSorterChoice& operator=(const SuffixSorterChoice&) = delete;
+private:
+	byte_sa_algo_type previous;
+};
+
+// Deletes the temporary files of an index construction when it goes out of scope, also if the construction throws.
+// A step that fails leaves its file behind before it has been registered, so the files of all steps are deleted by name.
+class ConstructionFilesCleanup {
+public:
+	ConstructionFilesCleanup(cache_config &cacheConfig) :
+			config(cacheConfig) {
+	}
+	~ConstructionFilesCleanup() {
+		for (const char *key : { conf::KEY_TEXT, conf::KEY_SA, conf::KEY_BWT }) {
+			std::remove(cache_file_name(key, config).c_str());
+		}
+		util::delete_all_files(config.file_map);
+	}
+	ConstructionFilesCleanup(const ConstructionFilesCleanup&) = delete;
+	ConstructionFilesCleanup& operator=(const ConstructionFilesCleanup&) = delete;
+private:
+	cache_config &config;
+};
+
+// Runs the same steps as sdsl::construct(fm_index, filepath, 1), but with the text packed from the input file if
+// necessary, the temporary files in the configured directory, the suffix sorter chosen by the memory budget and a
+// progress message after every step.
+// All steps run on a single thread: sdsl builds libdivsufsort without OpenMP, and builds the wavelet tree and the
+// samples from the BWT sequentially.
+void KmerCounter::constructIndex(const std::string &filepath) {
+	auto start = std::chrono::steady_clock::now();
+	auto reportProgress = [&start](const std::string &step) {
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		std::cout << "  " << step << " (" << seconds << " s)" << std::endl;
+	};
+	cache_config config(true, constructionOptions.tmpDir);
+	ConstructionFilesCleanup cleanup(config);
+	std::unique_ptr<SuffixSorterChoice> sorterChoice;
+	{
+		int_vector<8> text;
+		if (strandMode == IndexStrandMode::BOTH_STRANDS || SequenceLineReader::isFastqFile(filepath)) {
+			packText(filepath, text);
+		} else { // the text file is indexed as it is
+			load_vector_from_file(text, filepath, 1);
+		}
+		if (!contains_no_zero_symbol(text, filepath)) {
+			throw std::runtime_error("The text to be indexed contains a zero byte: " + filepath);
+		}
+		append_zero_symbol(text);
+		// the suffix sorters of sdsl read the text from the temporary directory, this is the only copy written to disk
+		store_to_cache(text, conf::KEY_TEXT, config);
+
+		// libdivsufsort needs the text and a suffix array of 32 or 64 bit integers in memory
+		double bytesPerSymbol = (text.size() < (1ULL << 31)) ? 5 : 9;
+		double memoryNeededMiB = bytesPerSymbol * text.size() / (1024.0 * 1024.0);
+		bool overBudget = constructionOptions.memoryBudgetMiB > 0
+				&& memoryNeededMiB > constructionOptions.memoryBudgetMiB;
+		sorterChoice.reset(new SuffixSorterChoice(overBudget ? SE_SAIS : LIBDIVSUFSORT));
+	}
+	register_cache_file(conf::KEY_TEXT, config);
+	reportProgress("Parsed text");
+
+	construct_sa<8>(config);
+	register_cache_file(conf::KEY_SA, config);
+	reportProgress(
+			(construct_config::byte_algo_sa == SE_SAIS) ?
+					"Built suffix array semi-externally" : "Built suffix array in memory");
+
+	construct_bwt<8>(config);
+	register_cache_file(conf::KEY_BWT, config);
+	reportProgress("Built BWT");
+
+	fm_index->construct(config);
+	reportProgress("Built wavelet tree and samples");
+}
+
+IndexStrandMode KmerCounter::getStrandMode() {
+	return strandMode;
+}
+
+FMIndexType KmerCounter::getIndexType() {
+	return indexType;
+}
+
+double KmerCounter::indexSizeInMegaBytes() {
+	return fm_index->sizeInMegaBytes();
+}
+
+// From now on, k-mers of size k consisting of A, C, G and T only are counted by a lookup in a hash table instead of
+// searching them in the FM index. The table is stored next to the .fm9 file.
+void KmerCounter::enableFixedSizeTable(size_t k) {
+	if (k > MAX_PACKED_KMER_SIZE) {
+		std::cout << "Note: k-mer size " << k << " is too large for a k-mer count table, using the FM index only."
 				<< std::endl;
+		return;
+	}
+	loadOrConstructFixedSizeTable(k);
+}
+
+// NULL if no fixed-size table has been enabled
+const KmerCountTable* KmerCounter::getFixedSizeTable() const {
+	return fixedSizeTable.get();
+}
+
+const std::string& KmerCounter::getTextFile() const {
+	return textFile;
+}
+
+void KmerCounter::loadOrConstructFixedSizeTable(size_t k) {
+	TextFileStamp textFileStamp = stampOfFile(textFile);
+	std::string table_file = textFile + ".k" + std::to_string(k) + ".kct";
+	fixedSizeTable.reset(new KmerCountTable(k));
+	if (!fixedSizeTable->loadTable(table_file, textFileStamp)) {
+		std::cout << "No k-mer count table for k = " << k << " found. Constructing k-mer count table..." << std::endl;
+		fixedSizeTable.reset(new KmerCountTable(k));
+		fixedSizeTable->buildFromFile(textFile);
+		fixedSizeTable->storeTable(table_file, textFileStamp);
+		std::cout << "K-mer count table construction complete, table requires " << fixedSizeTable->sizeInMegaBytes()
+				<< " MiB." << std::endl;
+	}
+}
+
+bool KmerCounter::countFromFixedSizeTable(const std::string &kmer, size_t &count) const {
+	uint64_t packed;
+	if (!fixedSizeTable || kmer.size() != fixedSizeTable->getKmerSize() || !packKmer(kmer, packed)) {
+		return false;
+	}
+	count = fixedSizeTable->countKmer(packed);
+	return true;
+}
+
+// From now on, k-mers of the given sizes consisting of A, C, G and T only are looked up in a KmerPrefilter before they
+// are counted by countKmer, countKmerNoRC, countKmerUpTo or a batch, and k-mers the filter rules out are not searched
+// at all. The variants walked by countKmerNeighbourhood are not filtered: they are extensions of the shared suffix
+// intervals, and the walk of an absent variant mostly ends after a few steps anyway. The filter is stored next to the
+// .fm9 file. If the fixed-size table is enabled first, its number of k-mers is used to size the filter.
+void KmerCounter::enablePrefilter(const std::vector<size_t> &kmerSizes) {
+	std::vector<size_t> supportedSizes;
+	for (size_t k : kmerSizes) {
+		if (k > 0 && k <= MAX_PACKED_KMER_SIZE) {
+			supportedSizes.push_back(k);
+		} else {
+			std::cout << "Note: k-mer size " << k << " is not supported by the k-mer prefilter." << std::endl;
+		}
 	}
+	if (!supportedSizes.empty()) {
+		loadOrConstructPrefilter(supportedSizes);
+	}
+}
+
+void KmerCounter::loadOrConstructPrefilter(const std::vector<size_t> &kmerSizes) {
+	TextFileStamp textFileStamp = stampOfFile(textFile);
+	std::string filter_file = textFile + ".kpf";
+	prefilter.reset(new KmerPrefilter(kmerSizes));
+	if (!prefilter->loadFilter(filter_file, textFileStamp)) {
+		std::cout << "No k-mer prefilter found. Constructing k-mer prefilter..." << std::endl;
+		prefilter.reset(new KmerPrefilter(kmerSizes));
+		// the number of distinct k-mers of neighboring sizes is about the same as the one of the table size
+		prefilter->buildFromFile(textFile, fixedSizeTable ? fixedSizeTable->getNumDistinctKmers() : 0);
+		prefilter->storeFilter(filter_file, textFileStamp);
+		std::cout << "K-mer prefilter construction complete, filter requires " << prefilter->sizeInMegaBytes()
+				<< " MiB." << std::endl;
+	}
+}
+
+// the threads are spread over the shards of the prefilter statistics in the order they first count something
+static size_t statisticsShardOfThread() {
+	static std::atomic<size_t> nextShard(0);
+	static thread_local size_t shard = nextShard++;
+	return shard;
+}
+
+// true if the prefilter proves that the k-mer does not occur, in which case it needs not be searched
+bool KmerCounter::prefilterRulesOut(const std::string &kmer) const {
+	uint64_t packed;
+	if (!prefilter || !prefilter->coversKmerSize(kmer.size()) || !packKmer(kmer, packed)) {
+		return false;
+	}
+	PrefilterStatistics &statistics = prefilterStatistics[statisticsShardOfThread() % NUM_PREFILTER_STATISTICS_SHARDS];
+	statistics.numQueries.fetch_add(1, std::memory_order_relaxed);
+	if (prefilter->definitelyAbsent(packed, kmer.size())) {
+		statistics.numSkippedSearches.fetch_add(1, std::memory_order_relaxed);
+		return true;
+	}
+	return false;
+}
+
+// If false, countKmer(kmer) is less than minCount. If true, it may or may not be.
+bool KmerCounter::mayOccurAtLeast(const std::string &kmer, size_t minCount) const {
+	uint64_t packed;
+	if (!prefilter || !prefilter->coversKmerSize(kmer.size()) || !packKmer(kmer, packed)) {
+		return true;
+	}
+	return prefilter->mayOccurAtLeast(packed, kmer.size(), minCount);
+}
+
+size_t KmerCounter::getNumPrefilterQueries() const {
+	size_t numQueries = 0;
+	for (const PrefilterStatistics &statistics : prefilterStatistics) {
+		numQueries += statistics.numQueries;
+	}
+	return numQueries;
+}
+
+size_t KmerCounter::getNumSkippedSearches() const {
+	size_t numSkippedSearches = 0;
+	for (const PrefilterStatistics &statistics : prefilterStatistics) {
+		numSkippedSearches += statistics.numSkippedSearches;
+	}
+	return numSkippedSearches;
 }
 
 void KmerCounter::clearBuffers() {
@@ -51,88 +402,366 @@ void KmerCounter::clearBuffers() {
 }
 
 size_t KmerCounter::countKmer(const std::string &kmer) {
+	size_t count;
+	if (countFromFixedSizeTable(kmer, count)) {
+		return count;
+	}
+	if (prefilterRulesOut(kmer)) {
+		return 0;
+	}
+	if (strandMode == IndexStrandMode::BOTH_STRANDS) {
+		size_t begin, end;
+		return searchInterval(kmer, begin, end);
+	}
 	size_t countOriginal = countKmerNoRC(kmer);
 	std::string kmerRC = reverseComplementString(kmer);
 	size_t countRC = countKmerNoRC(kmerRC);
 	return countOriginal + countRC;
 }
 
+// Returns countKmer(kmer) if it is at least floor and less than limit, some value below floor if the count is, and
+// some value of at least limit otherwise. The search stops as soon as the interval of the k-mer, together with the one
+// of its reverse complement, holds less than floor occurrences, and the reverse complement is not searched once the
+// k-mer alone occurs limit times.
+size_t KmerCounter::countKmerUpTo(const std::string &kmer, size_t floor, size_t limit) {
+	size_t count;
+	if (countFromFixedSizeTable(kmer, count)) {
+		return count;
+	}
+	if (prefilterRulesOut(kmer)) {
+		return 0;
+	}
+	size_t begin, end;
+	if (strandMode == IndexStrandMode::BOTH_STRANDS) {
+		// the interval covers the occurrences on both strands at once
+		return searchInterval(kmer, begin, end, floor);
+	}
+	size_t countOriginal = searchInterval(kmer, begin, end);
+	if (countOriginal >= limit) {
+		return countOriginal;
+	}
+	std::string kmerRC = reverseComplementString(kmer);
+	return countOriginal + searchInterval(kmerRC, begin, end, floor > countOriginal ? floor - countOriginal : 0);
+}
+
+// The variants of the k-mer are weighted by the error profile of the k-mer, the variants of its reverse complement by
+// the profile of the reverse complement. On an index over both strands, every search counts the occurrences of a
+// variant together with the ones of its reverse complement, which the weights cannot be told apart for. There the
+// variants of the k-mer and of its reverse complement are both searched, each weighted by its own profile, and the
+// result is half of their sum: the same as on a forward-only index if the profile weights a variant and its reverse
+// complement alike, or if they occur equally often in the text, and in between the two weightings otherwise.
 double KmerCounter::countKmerApproximate(const std::string &kmer,
 		const std::shared_ptr<ErrorProfileUnit> &errorProfile) {
-	double countOriginal = countKmerNoRCApproximate(kmer, errorProfile);
 	std::string kmerRC = reverseComplementString(kmer);
+	if (strandMode == IndexStrandMode::BOTH_STRANDS) {
+		return (countApproximateSingleSearch(kmer, errorProfile) + countApproximateSingleSearch(kmerRC, errorProfile))
+				/ 2;
+	}
+	double countOriginal = countKmerNoRCApproximate(kmer, errorProfile);
 	double countRC = countKmerNoRCApproximate(kmerRC, errorProfile);
 	return countOriginal + countRC;
 }
 
 size_t KmerCounter::countKmerNoRC(const std::string &kmer) {
+	if (strandMode == IndexStrandMode::BOTH_STRANDS) {
+		throw std::runtime_error("countKmerNoRC is not available on an index built over both strands!");
+	}
 	/*if ((kmer.size() < 17) && (buffer.find(kmer) != buffer.end())) {
 		return buffer[kmer];
 	}*/
-	size_t countOriginal = sdsl::count(fm_index, kmer.begin(), kmer.end());
+	if (prefilterRulesOut(kmer)) {
+		return 0;
+	}
+	size_t begin, end;
+	size_t countOriginal = searchInterval(kmer, begin, end);
 	/*if (kmer.size() < 17 && countOriginal >= 50) {
 		buffer[kmer] = countOriginal;
 	}*/
 	return countOriginal;
 }
 
-std::string KmerCounter::kmerAfterError(const std::string &kmer, ErrorType error, size_t posOfError) {
-	std::string res = kmer;
-	if (error == ErrorType::SUB_FROM_A) {
-		res[posOfError] = 'A';
-	} else if (error == ErrorType::SUB_FROM_C) {
-		res[posOfError] = 'C';
-	} else if (error == ErrorType::SUB_FROM_G) {
-		res[posOfError] = 'G';
-	} else if (error == ErrorType::SUB_FROM_T) {
-		res[posOfError] = 'T';
-	} else if (error == ErrorType::INSERTION) {
-		res = kmer.substr(0, posOfError) + kmer.substr(posOfError + 1, kmer.size());
-	} else if (error == ErrorType::DEL_OF_A) {
-		res = kmer.substr(0, posOfError + 1) + "A" + kmer.substr(posOfError + 1, kmer.size());
-	} else if (error == ErrorType::DEL_OF_C) {
-		res = kmer.substr(0, posOfError + 1) + "C" + kmer.substr(posOfError + 1, kmer.size());
-	} else if (error == ErrorType::DEL_OF_G) {
-		res = kmer.substr(0, posOfError + 1) + "G" + kmer.substr(posOfError + 1, kmer.size());
-	} else if (error == ErrorType::DEL_OF_T) {
-		res = kmer.substr(0, posOfError + 1) + "T" + kmer.substr(posOfError + 1, kmer.size());
-	} else {
-		throw std::runtime_error("Wrong error type given: " + errorTypeToString(error));
+// Same results as calling countKmer on every k-mer of the batch.
+std::vector<size_t> KmerCounter::countKmers(const std::vector<std::string> &kmers) {
+	std::vector<size_t> counts(kmers.size());
+	// k-mers found in the fixed-size table are answered directly, only the remaining ones are searched in the index
+	std::vector<size_t> searched;
+	std::vector<std::string> kmersToSearch;
+	for (size_t i = 0; i < kmers.size(); ++i) {
+		if (!countFromFixedSizeTable(kmers[i], counts[i])) {
+			searched.push_back(i);
+			kmersToSearch.push_back(kmers[i]);
+			if (strandMode == IndexStrandMode::FORWARD_ONLY) {
+				kmersToSearch.push_back(reverseComplementString(kmers[i]));
+			}
+		}
+	}
+	std::vector<size_t> searchCounts;
+	countBatch(kmersToSearch, searchCounts);
+	for (size_t i = 0; i < searched.size(); ++i) {
+		if (strandMode == IndexStrandMode::BOTH_STRANDS) {
+			counts[searched[i]] = searchCounts[i];
+		} else {
+			counts[searched[i]] = searchCounts[2 * i] + searchCounts[2 * i + 1];
+		}
 	}
+	return counts;
+}
 
-	return res;
+// Same results as calling countKmerNoRC on every k-mer of the batch.
+std::vector<size_t> KmerCounter::countKmersNoRC(const std::vector<std::string> &kmers) {
+	if (strandMode == IndexStrandMode::BOTH_STRANDS) {
+		throw std::runtime_error("countKmersNoRC is not available on an index built over both strands!");
+	}
+	std::vector<size_t> counts;
+	countBatch(kmers, counts);
+	return counts;
+}
+
+// Every level of the rank queries of a backward search step is a dependent cache miss, so counting k-mers one after
+// the other keeps the processor waiting on memory most of the time. Here up to COUNT_BATCH_WIDTH searches are
+// advanced in lockstep, and the FM index walks the rank queries of each step through its wavelet tree level by level
+// for all of them, prefetching the words of every next level, so the misses of independent searches overlap on every
+// level. A finished search hands its slot to the next k-mer.
+void KmerCounter::countBatch(const std::vector<std::string> &kmers, std::vector<size_t> &counts) const {
+	static const size_t COUNT_BATCH_WIDTH = 16;
+	size_t begin[COUNT_BATCH_WIDTH];
+	size_t end[COUNT_BATCH_WIDTH];
+	size_t remaining[COUNT_BATCH_WIDTH];
+	size_t query[COUNT_BATCH_WIDTH];
+	char bases[COUNT_BATCH_WIDTH];
+	size_t numActive = 0;
+	size_t nextQuery = 0;
+
+	counts.resize(kmers.size());
+	while (nextQuery < kmers.size() || numActive > 0) {
+		while (numActive < COUNT_BATCH_WIDTH && nextQuery < kmers.size()) {
+			if (kmers[nextQuery].empty()) {
+				counts[nextQuery] = fm_index->size();
+				nextQuery++;
+				continue;
+			}
+			if (prefilterRulesOut(kmers[nextQuery])) {
+				counts[nextQuery] = 0;
+				nextQuery++;
+				continue;
+			}
+			query[numActive] = nextQuery;
+			begin[numActive] = 0;
+			end[numActive] = fm_index->size();
+			remaining[numActive] = kmers[nextQuery].size();
+			numActive++;
+			nextQuery++;
+		}
+		for (size_t i = 0; i < numActive; ++i) {
+			remaining[i]--;
+			bases[i] = kmers[query[i]][remaining[i]];
+		}
+		fm_index->extendIntervals(begin, end, bases, numActive);
+		size_t i = 0;
+		while (i < numActive) {
+			if (remaining[i] == 0 || begin[i] >= end[i]) {
+				counts[query[i]] = (begin[i] < end[i]) ? end[i] - begin[i] : 0;
+				numActive--;
+				query[i] = query[numActive];
+				begin[i] = begin[numActive];
+				end[i] = end[numActive];
+				remaining[i] = remaining[numActive];
+			} else {
+				i++;
+			}
+		}
+	}
 }
 
-// TODO: This currently only accounts for single-base errors.
 double KmerCounter::countKmerNoRCApproximate(const std::string &kmer,
 		const std::shared_ptr<ErrorProfileUnit> &errorProfile) {
+	if (strandMode == IndexStrandMode::BOTH_STRANDS) {
+		throw std::runtime_error("countKmerNoRCApproximate is not available on an index built over both strands!");
+	}
+	return countApproximateSingleSearch(kmer, errorProfile);
+}
+
+// TODO: This currently only accounts for single-base errors.
+double KmerCounter::countApproximateSingleSearch(const std::string &kmer,
+		const std::shared_ptr<ErrorProfileUnit> &errorProfile) {
 	/*if ((kmer.size() < 17) && (bufferApprox.find(kmer) != bufferApprox.end())) {
 		return bufferApprox[kmer];
 	}*/
-	double countOriginal = sdsl::count(fm_index, kmer.begin(), kmer.end());
+	double countTotal = countKmerNeighbourhood(kmer, errorProfile->getKmerErrorProbabilities(kmer));
+	/*if (kmer.size() < 17 && countTotal >= 50) {
+		bufferApprox[kmer] = countTotal;
+	}*/
+	return countTotal;
+}
+
+static double probabilityOf(const std::unordered_map<ErrorType, double> &probabilities, ErrorType type) {
+	auto it = probabilities.find(type);
+	return (it == probabilities.end()) ? 0 : it->second;
+}
+
+// Sums up the counts of the k-mer and of all of its variants after a single error, weighted by the exponentials of the
+// given log-probabilities of the errors at every position. The counts are searched on the strands the index has been
+// built over.
+// All variants share a suffix with the k-mer: a variant with an error at position i is the interval of kmer[i+1..]
+// extended by at most one base of the error and then by kmer[0..i] from right to left. So the intervals of all
+// suffixes are searched once, and each variant costs only the steps left of its error, which mostly end early because
+// the interval of an erroneous k-mer quickly becomes empty.
+double KmerCounter::countKmerNeighbourhood(const std::string &kmer,
+		const std::vector<std::unordered_map<ErrorType, double> > &errorProbabilities) const {
+	size_t k = kmer.size();
+	std::vector<size_t> suffixBegin(k + 1);
+	std::vector<size_t> suffixEnd(k + 1);
+	suffixBegin[k] = 0;
+	suffixEnd[k] = fm_index->size();
+	for (size_t j = k; j > 0; --j) {
+		suffixBegin[j - 1] = suffixBegin[j];
+		suffixEnd[j - 1] = suffixEnd[j];
+		extendInterval(suffixBegin[j - 1], suffixEnd[j - 1], kmer[j - 1]);
+	}
+
 	double countTotal = 0;
-	auto profileInformation = errorProfile->getKmerErrorProbabilities(kmer);
 	double probCorrect = 0;
-	for (size_t i = 0; i < profileInformation.size(); ++i) {
-		for (auto kv : profileInformation[i]) {
-			if (kv.first != ErrorType::CORRECT && kv.first != ErrorType::NODEL && kv.first != ErrorType::MULTIDEL) {
-				std::string kmerAfterCorrection = kmerAfterError(kmer, kv.first, i);
-				countTotal += exp(kv.second)
-						* sdsl::count(fm_index, kmerAfterCorrection.begin(), kmerAfterCorrection.end());
+	for (size_t i = 0; i < errorProbabilities.size(); ++i) {
+		for (auto kv : errorProbabilities[i]) {
+			if (kv.first == ErrorType::CORRECT || kv.first == ErrorType::NODEL || kv.first == ErrorType::MULTIDEL) {
+				continue;
+			}
+			size_t begin = suffixBegin[i + 1];
+			size_t end = suffixEnd[i + 1];
+			size_t prefixLength = i; // kmer[0..prefixLength) is left of the error
+			switch (kv.first) {
+			case ErrorType::SUB_FROM_A:
+				extendInterval(begin, end, 'A');
+				break;
+			case ErrorType::SUB_FROM_C:
+				extendInterval(begin, end, 'C');
+				break;
+			case ErrorType::SUB_FROM_G:
+				extendInterval(begin, end, 'G');
+				break;
+			case ErrorType::SUB_FROM_T:
+				extendInterval(begin, end, 'T');
+				break;
+			case ErrorType::INSERTION: // the inserted base is skipped
+				break;
+			case ErrorType::DEL_OF_A: // the deleted base follows the base at position i
+				extendInterval(begin, end, 'A');
+				prefixLength = i + 1;
+				break;
+			case ErrorType::DEL_OF_C:
+				extendInterval(begin, end, 'C');
+				prefixLength = i + 1;
+				break;
+			case ErrorType::DEL_OF_G:
+				extendInterval(begin, end, 'G');
+				prefixLength = i + 1;
+				break;
+			case ErrorType::DEL_OF_T:
+				extendInterval(begin, end, 'T');
+				prefixLength = i + 1;
+				break;
+			default:
+				throw std::runtime_error("Wrong error type given: " + errorTypeToString(kv.first));
 			}
+			for (size_t j = prefixLength; j > 0 && begin < end; --j) {
+				extendInterval(begin, end, kmer[j - 1]);
+			}
+			size_t count = (begin < end) ? end - begin : 0;
+			countTotal += exp(kv.second) * count;
 		}
-		probCorrect += profileInformation[i][ErrorType::CORRECT] + profileInformation[i][ErrorType::NODEL];
+		probCorrect += probabilityOf(errorProbabilities[i], ErrorType::CORRECT)
+				+ probabilityOf(errorProbabilities[i], ErrorType::NODEL);
 	}
-	countTotal += exp(probCorrect) * countOriginal;
-
-	/*if (kmer.size() < 17 && countTotal >= 50) {
-		bufferApprox[kmer] = countTotal;
-	}*/
+	countTotal += exp(probCorrect) * (suffixEnd[0] - suffixBegin[0]);
 	return countTotal;
 }
 
+KmerCursor KmerCounter::startCursor(const std::string &kmer) const {
+	KmerCursor cursor(this);
+	cursor.sequence = kmer;
+	searchInterval(kmer, cursor.fwdBegin, cursor.fwdEnd);
+	for (size_t i = 0; i < kmer.size(); ++i) {
+		if (kmer[i] == 'G' || kmer[i] == 'C') {
+			cursor.numGC++;
+		}
+	}
+	cursor.twinValid = kmer.empty();
+	return cursor;
+}
+
+// one backward search step on the half-open interval [begin, end)
+void KmerCounter::extendInterval(size_t &begin, size_t &end, char base) const {
+	if (begin >= end) {
+		begin = end;
+		return;
+	}
+	fm_index->extendInterval(begin, end, base);
+}
+
+// Returns the size of the interval of the k-mer, or some smaller size below floor once the interval shrinks below it.
+size_t KmerCounter::searchInterval(const std::string &kmer, size_t &begin, size_t &end, size_t floor) const {
+	begin = 0;
+	end = fm_index->size();
+	for (size_t i = kmer.size(); i > 0 && begin < end && end - begin >= floor; --i) {
+		extendInterval(begin, end, kmer[i - 1]);
+	}
+	return end - begin;
+}
+
+// Extends [begin, end) to the left by base and its twin [twinBegin, twinEnd) to the right by the complement of base.
+// The right extensions of the twin are sorted by the appended base, and each of them occurs as often as the
+// corresponding left extension of the k-mer. Contexts ending in a separator sort in front of all of them.
+void KmerCounter::extendIntervalBidirectional(size_t &begin, size_t &end, size_t &twinBegin, size_t &twinEnd,
+		char base) const {
+	static const char bases[5] = { 'A', 'C', 'G', 'N', 'T' };
+	static const int complementIdx[5] = { 4, 2, 1, 3, 0 };
+	size_t extBegin[5];
+	size_t extEnd[5];
+	size_t total = 0;
+	int idx = -1;
+	for (size_t i = 0; i < 5; ++i) {
+		extBegin[i] = begin;
+		extEnd[i] = end;
+		extendInterval(extBegin[i], extEnd[i], bases[i]);
+		total += extEnd[i] - extBegin[i];
+		if (bases[i] == base) {
+			idx = i;
+		}
+	}
+	if (idx == -1) { // not a base, so the extended k-mer does not occur
+		begin = end = twinBegin = twinEnd = 0;
+		return;
+	}
+	size_t newTwinBegin = twinBegin + (end - begin - total);
+	for (int i = 0; i < 5; ++i) {
+		if (bases[complementIdx[i]] < bases[complementIdx[idx]]) {
+			newTwinBegin += extEnd[i] - extBegin[i];
+		}
+	}
+	begin = extBegin[idx];
+	end = extEnd[idx];
+	twinBegin = newTwinBegin;
+	twinEnd = newTwinBegin + (end - begin);
+}
+
+char KmerCounter::complementBase(char base) {
+	switch (base) {
+	case 'A':
+		return 'T';
+	case 'C':
+		return 'G';
+	case 'G':
+		return 'C';
+	case 'T':
+		return 'A';
+	default:
+		return base;
+	}
+}
+
 std::string KmerCounter::reverseComplementString(const std::string &sequence) {
 	std::string rc = "";
+	rc.reserve(sequence.size());
 	for (int i = sequence.size() - 1; i >= 0; i--) {
 		assert(i >= 0);
 		if (sequence[i] == 'A') {
@@ -151,3 +780,77 @@ std::string KmerCounter::reverseComplementString(const std::string &sequence) {
 	}
 	return rc;
 }
+
+KmerCursor::KmerCursor() {
+	counter = NULL;
+	fwdBegin = fwdEnd = rcBegin = rcEnd = 0;
+	twinValid = false;
+	numGC = 0;
+}
+
+KmerCursor::KmerCursor(const KmerCounter *kmerCounter) {
+	counter = kmerCounter;
+	fwdBegin = rcBegin = 0;
+	fwdEnd = rcEnd = counter->fm_index->size();
+	twinValid = true;
+	numGC = 0;
+}
+
+void KmerCursor::ensureTwin() {
+	if (!twinValid && fwdBegin >= fwdEnd) {
+		rcBegin = rcEnd = 0;
+		twinValid = true;
+	} else if (!twinValid) {
+		counter->searchInterval(KmerCounter::reverseComplementString(sequence), rcBegin, rcEnd);
+		twinValid = true;
+	}
+}
+
+void KmerCursor::extendLeft(char base) {
+	sequence.insert(sequence.begin(), base);
+	if (base == 'G' || base == 'C') {
+		numGC++;
+	}
+	if (counter->bidirectional && twinValid) {
+		counter->extendIntervalBidirectional(fwdBegin, fwdEnd, rcBegin, rcEnd, base);
+	} else {
+		counter->extendInterval(fwdBegin, fwdEnd, base);
+		twinValid = false;
+	}
+}
+
+void KmerCursor::extendRight(char base) {
+	if (counter->bidirectional) {
+		ensureTwin();
+		counter->extendIntervalBidirectional(rcBegin, rcEnd, fwdBegin, fwdEnd, KmerCounter::complementBase(base));
+	}
+	sequence.push_back(base);
+	if (base == 'G' || base == 'C') {
+		numGC++;
+	}
+	if (!counter->bidirectional) {
+		counter->searchInterval(sequence, fwdBegin, fwdEnd);
+		twinValid = false;
+	}
+}
+
+size_t KmerCursor::count() const {
+	size_t occ = fwdEnd - fwdBegin;
+	if (counter->strandMode == IndexStrandMode::BOTH_STRANDS) {
+		return occ;
+	}
+	size_t begin, end;
+	return occ + counter->searchInterval(KmerCounter::reverseComplementString(sequence), begin, end);
+}
+
+size_t KmerCursor::size() const {
+	return sequence.size();
+}
+
+size_t KmerCursor::gcCount() const {
+	return numGC;
+}
+
+const std::string& KmerCursor::kmer() const {
+	return sequence;
+}
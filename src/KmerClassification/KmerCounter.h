@@ -7,39 +7,138 @@
 
 #pragma once
 
-#include <sdsl/csa_wt.hpp>
-#include <sdsl/int_vector.hpp>
-#include <sdsl/rank_support_v5.hpp>
-#include <sdsl/select_support_scan.hpp>
-#include <sdsl/wt_huff.hpp>
-#include <sdsl/suffix_arrays.hpp>
 #include <stddef.h>
+#include <atomic>
 #include <memory>
 #include <string>
 #include <unordered_map>
+#include <vector>
 #include "../ErrorProfile/ErrorProfileUnit.hpp"
+#include "FMIndexVariants.h"
+#include "KmerCountTable.h"
+#include "KmerPrefilter.h"
 
+#include "../DerivedFile.h"
 #include "../ErrorType.h"
 
 using namespace sdsl;
 
-typedef csa_wt<wt_huff<bit_vector, rank_support_v5<>, select_support_scan<>, select_support_scan<0>>, 1 << 20, 1 << 20> FMIndex;
+/*
+ * FORWARD_ONLY indexes the text as it is, so the canonical count of a k-mer needs a second search for its reverse complement.
+ * BOTH_STRANDS indexes every line of the text followed by its reverse complement, so a single search already returns the canonical count.
+ * The mode is chosen when the .fm9 file is built and recorded in its header.
+ */
+enum class IndexStrandMode {
+	FORWARD_ONLY = 0, BOTH_STRANDS = 1
+};
+
+/*
+ * Settings for building a new FM index. The temporary files of sdsl are written to tmpDir. If the in-memory suffix
+ * sorter would need more than memoryBudgetMiB (0 means no limit), the suffix array is built by the semi-external SE-SAIS
+ * of sdsl instead, which keeps the text in memory but streams the suffix array through tmpDir. All settings lead to the
+ * same index. The construction runs on a single thread: there is no parallel suffix sorter or wavelet tree builder, and
+ * no fully external construction for texts that do not fit into memory.
+ */
+struct IndexConstructionOptions {
+	std::string tmpDir = "./";
+	size_t memoryBudgetMiB = 0;
+};
+
+class KmerCounter;
+
+/*
+ * Keeps the suffix array interval of a k-mer in the FM index of a KmerCounter, so that growing the k-mer by one base
+ * costs a single backward search step instead of counting the whole string again.
+ * On an index built over both strands, the index is its own bidirectional BWT (like the FMD-index): the interval of the
+ * reverse complement is kept as a twin, which also allows extending the k-mer to the right in O(1) rank operations.
+ * On a forward-only index, extending to the right and counting the reverse complement fall back to full searches.
+ */
+class KmerCursor {
+public:
+	KmerCursor();
+	void extendLeft(char base);
+	void extendRight(char base);
+	size_t count() const;
+	size_t size() const;
+	size_t gcCount() const;
+	const std::string& kmer() const;
+private:
+	friend class KmerCounter;
+	KmerCursor(const KmerCounter *kmerCounter);
+	void ensureTwin();
+
+	const KmerCounter *counter;
+	size_t fwdBegin, fwdEnd; // half-open interval of the k-mer
+	size_t rcBegin, rcEnd; // half-open interval of its reverse complement, only maintained once twinValid is set
+	bool twinValid;
+	std::string sequence;
+	size_t numGC;
+};
 
 class KmerCounter {
 public:
-	KmerCounter(const std::string &filepath);
+	KmerCounter(const std::string &filepath, IndexStrandMode mode = IndexStrandMode::FORWARD_ONLY,
+			FMIndexType type = FMIndexType::HUFF_COMPACT,
+			const IndexConstructionOptions &options = IndexConstructionOptions());
 	size_t countKmer(const std::string &kmer);
+	size_t countKmerUpTo(const std::string &kmer, size_t floor, size_t limit);
 	double countKmerApproximate(const std::string &kmer, const std::shared_ptr<ErrorProfileUnit> &errorProfile);
 	size_t countKmerNoRC(const std::string &kmer);
+	std::vector<size_t> countKmers(const std::vector<std::string> &kmers);
+	std::vector<size_t> countKmersNoRC(const std::vector<std::string> &kmers);
 	double countKmerNoRCApproximate(const std::string &kmer, const std::shared_ptr<ErrorProfileUnit> &errorProfile);
+	double countKmerNeighbourhood(const std::string &kmer,
+			const std::vector<std::unordered_map<ErrorType, double> > &errorProbabilities) const;
 	void clearBuffers();
 	void changeFile(const std::string &filepath);
+	IndexStrandMode getStrandMode();
+	FMIndexType getIndexType();
+	double indexSizeInMegaBytes();
+	void enableFixedSizeTable(size_t k);
+	const KmerCountTable* getFixedSizeTable() const;
+	const std::string& getTextFile() const;
+	void enablePrefilter(const std::vector<size_t> &kmerSizes);
+	bool mayOccurAtLeast(const std::string &kmer, size_t minCount) const;
+	size_t getNumPrefilterQueries() const;
+	size_t getNumSkippedSearches() const;
+	KmerCursor startCursor(const std::string &kmer) const;
 private:
-	std::string reverseComplementString(const std::string &sequence);
-	std::string kmerAfterError(const std::string &kmer, ErrorType error, size_t posOfError);
-	FMIndex fm_index;
+	friend class KmerCursor;
+	void loadOrConstructIndex(const std::string &filepath);
+	bool loadIndex(const std::string &indexFile, const TextFileStamp &textFileStamp);
+	void storeIndex(const std::string &indexFile, const TextFileStamp &textFileStamp);
+	void constructIndex(const std::string &filepath);
+	void packText(const std::string &filepath, int_vector<8> &text);
+	void checkBidirectional();
+	void loadOrConstructFixedSizeTable(size_t k);
+	bool countFromFixedSizeTable(const std::string &kmer, size_t &count) const;
+	void loadOrConstructPrefilter(const std::vector<size_t> &kmerSizes);
+	bool prefilterRulesOut(const std::string &kmer) const;
+	void extendInterval(size_t &begin, size_t &end, char base) const;
+	void extendIntervalBidirectional(size_t &begin, size_t &end, size_t &twinBegin, size_t &twinEnd, char base) const;
+	size_t searchInterval(const std::string &kmer, size_t &begin, size_t &end, size_t floor = 0) const;
+	void countBatch(const std::vector<std::string> &kmers, std::vector<size_t> &counts) const;
+	static std::string reverseComplementString(const std::string &sequence);
+	static char complementBase(char base);
+	double countApproximateSingleSearch(const std::string &kmer, const std::shared_ptr<ErrorProfileUnit> &errorProfile);
+	std::unique_ptr<FMIndexInterface> fm_index;
+	FMIndexType indexType;
+	IndexConstructionOptions constructionOptions;
+	IndexStrandMode requestedMode;
+	IndexStrandMode strandMode;
+	bool bidirectional;
+	std::string textFile;
+	std::unique_ptr<KmerCountTable> fixedSizeTable; // exact counts for a single k-mer size, only set if enabled
+	std::unique_ptr<KmerPrefilter> prefilter; // rules out absent k-mers of a few sizes, only set if enabled
+	// The prefilter is queried for every k-mer by every correction thread, so the threads count into shards of their
+	// own, each on a cache line of its own, instead of contending for a single one.
+	struct alignas(64) PrefilterStatistics {
+		std::atomic<size_t> numQueries;
+		std::atomic<size_t> numSkippedSearches;
+	};
+	static const size_t NUM_PREFILTER_STATISTICS_SHARDS = 16;
+	mutable PrefilterStatistics prefilterStatistics[NUM_PREFILTER_STATISTICS_SHARDS];
 
 	std::unordered_map<std::string, size_t> buffer;
 	std::unordered_map<std::string, size_t> bufferApprox;
 };
-
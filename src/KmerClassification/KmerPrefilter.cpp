@@ -0,0 +1,222 @@
+/*
+ * KmerPrefilter.cpp
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: sarah
+ */
+
+#include "KmerPrefilter.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+#include "PackedKmer.h"
+#include "../SequenceLineReader.h"
+
+// written in front of a stored filter
+static const char FILTER_MAGIC[8] = { 'P', 'A', 'E', 'C', 'K', 'P', 'F', '2' };
+static const size_t WORDS_PER_BLOCK = 8;
+static const size_t PROBES_PER_KMER = 4;
+static const uint64_t MAX_COUNTER = 15;
+// The filter gets the smallest power of two of blocks that holds at most this many distinct k-mers per block on average,
+// so the average load is between 4 and 8. Then between about one in 2000 and one in 260 absent k-mers passes the filter
+// (0.05% to 0.4%), the chance that all of its four counters are hit by the Poisson-distributed k-mers of its block.
+static const size_t KMERS_PER_BLOCK = 8;
+// number of lines that are read from the file before they are counted in parallel
+static const size_t LINES_PER_CHUNK = 100000;
+
+KmerPrefilter::KmerPrefilter(const std::vector<size_t> &kmerSizes) {
+	for (size_t k : kmerSizes) {
+		if (k == 0 || k > MAX_PACKED_KMER_SIZE) {
+			throw std::runtime_error("K-mer prefilters only support k-mer sizes from 1 to 31!");
+		}
+	}
+	this->kmerSizes = kmerSizes;
+	std::sort(this->kmerSizes.begin(), this->kmerSizes.end());
+	this->kmerSizes.erase(std::unique(this->kmerSizes.begin(), this->kmerSizes.end()), this->kmerSizes.end());
+	blockMask = 0;
+	words.assign(WORDS_PER_BLOCK, 0);
+}
+
+const std::vector<size_t>& KmerPrefilter::getKmerSizes() const {
+	return kmerSizes;
+}
+
+bool KmerPrefilter::coversKmerSize(size_t k) const {
+	return std::binary_search(kmerSizes.begin(), kmerSizes.end(), k);
+}
+
+double KmerPrefilter::sizeInMegaBytes() const {
+	return words.size() * sizeof(uint64_t) / (1024.0 * 1024.0);
+}
+
+// The k-mer size is mixed into the hash, so that k-mers of different sizes with the same packed value are independent.
+// The upper bits select the block, four groups of 7 lower bits select the counters within the block.
+static inline uint64_t prefilterHash(uint64_t canonical, size_t k) {
+	return hashPacked(canonical ^ (k * 0x9e3779b97f4a7c15ULL));
+}
+
+// Thread-safe.
+void KmerPrefilter::insertCanonical(uint64_t canonical, size_t k) {
+	uint64_t hash = prefilterHash(canonical, k);
+	uint64_t *block = &words[((hash >> 32) & blockMask) * WORDS_PER_BLOCK];
+	for (size_t i = 0; i < PROBES_PER_KMER; ++i) {
+		size_t counter = (hash >> (7 * i)) & 127;
+		uint64_t *word = &block[counter >> 4];
+		size_t shift = (counter & 15) * 4;
+		uint64_t old = __atomic_load_n(word, __ATOMIC_RELAXED);
+		while (((old >> shift) & MAX_COUNTER) < MAX_COUNTER) {
+			if (__atomic_compare_exchange_n(word, &old, old + (1ULL << shift), true, __ATOMIC_RELAXED,
+					__ATOMIC_RELAXED)) {
+				break;
+			}
+		}
+	}
+}
+
+// the smallest counter of the k-mer, it is at least the number of occurrences of its canonical k-mer (or saturated)
+size_t KmerPrefilter::upperBound(uint64_t packedKmer, size_t k) const {
+	uint64_t hash = prefilterHash(canonicalPacked(packedKmer, k), k);
+	const uint64_t *block = &words[((hash >> 32) & blockMask) * WORDS_PER_BLOCK];
+	uint64_t minCounter = MAX_COUNTER;
+	for (size_t i = 0; i < PROBES_PER_KMER; ++i) {
+		size_t counter = (hash >> (7 * i)) & 127;
+		minCounter = std::min(minCounter, (block[counter >> 4] >> ((counter & 15) * 4)) & MAX_COUNTER);
+	}
+	return minCounter;
+}
+
+// If true, the k-mer occurs neither on the forward nor on the reverse strand of the text.
+bool KmerPrefilter::definitelyAbsent(uint64_t packedKmer, size_t k) const {
+	return upperBound(packedKmer, k) == 0;
+}
+
+// If false, the k-mer and its reverse complement together occur less than minCount times in the text.
+bool KmerPrefilter::mayOccurAtLeast(uint64_t packedKmer, size_t k, size_t minCount) const {
+	size_t bound = upperBound(packedKmer, k);
+	if (bound == MAX_COUNTER) {
+		return true;
+	}
+	if (reverseComplementPacked(packedKmer, k) == packedKmer) { // palindromes count once per strand
+		bound *= 2;
+	}
+	return bound >= minCount;
+}
+
+// Counts all windows of the filtered sizes that consist of A, C, G and T only, by their canonical k-mer.
+void KmerPrefilter::countLine(const std::string &line) {
+	if (!line.empty() && line[0] == '>') {
+		return;
+	}
+	for (size_t k : kmerSizes) {
+		uint64_t mask = packedKmerMask(k);
+		size_t shift = 2 * (k - 1);
+		uint64_t fwd = 0;
+		uint64_t rc = 0;
+		size_t numValid = 0;
+		for (size_t i = 0; i < line.size(); ++i) {
+			uint64_t code = packBase(line[i]);
+			if (code > 3) {
+				numValid = 0;
+				continue;
+			}
+			fwd = ((fwd << 2) | code) & mask;
+			rc = (rc >> 2) | ((3 - code) << shift);
+			numValid++;
+			if (numValid >= k) {
+				insertCanonical(std::min(fwd, rc), k);
+			}
+		}
+	}
+}
+
+// The filter is sized for expectedDistinctKmers distinct k-mers of each size. If it is 0, every window of the text is
+// assumed to be a different k-mer, which is far too pessimistic for reads with a high coverage.
+void KmerPrefilter::buildFromFile(const std::string &filepath, size_t expectedDistinctKmers) {
+	std::ifstream infile(filepath, std::ios::binary | std::ios::ate);
+	if (!infile.good()) {
+		throw std::runtime_error("This file does not exist! " + filepath);
+	}
+	if (expectedDistinctKmers == 0) { // the file size bounds the number of windows
+		expectedDistinctKmers = infile.tellg();
+	}
+	SequenceLineReader reader(filepath);
+	size_t numKmers = expectedDistinctKmers * kmerSizes.size();
+	size_t numBlocks = 1;
+	while (numBlocks * KMERS_PER_BLOCK < numKmers) {
+		numBlocks *= 2;
+	}
+	blockMask = numBlocks - 1;
+	words.assign(numBlocks * WORDS_PER_BLOCK, 0);
+
+	std::vector<std::string> lines;
+	lines.reserve(LINES_PER_CHUNK);
+	std::string line;
+	bool linesLeft = true;
+	while (linesLeft) {
+		lines.clear();
+		while (lines.size() < LINES_PER_CHUNK && reader.nextLine(line)) {
+			lines.push_back(line);
+		}
+		linesLeft = (lines.size() == LINES_PER_CHUNK);
+#pragma omp parallel for schedule(dynamic, 64)
+		for (size_t i = 0; i < lines.size(); ++i) {
+			countLine(lines[i]);
+		}
+	}
+}
+
+bool KmerPrefilter::loadFilter(const std::string &filterFile, const TextFileStamp &textFileStamp) {
+	std::ifstream infile(filterFile, std::ios::binary);
+	if (!infile.good()) {
+		return false;
+	}
+	char magic[sizeof(FILTER_MAGIC)];
+	uint32_t numSizes;
+	infile.read(magic, sizeof(magic));
+	infile.read((char*) &numSizes, sizeof(numSizes));
+	if (!infile.good() || !std::equal(magic, magic + sizeof(magic), FILTER_MAGIC) || numSizes != kmerSizes.size()) {
+		return false;
+	}
+	for (size_t i = 0; i < numSizes; ++i) {
+		uint32_t k;
+		infile.read((char*) &k, sizeof(k));
+		if (!infile.good() || k != kmerSizes[i]) {
+			return false;
+		}
+	}
+	TextFileStamp storedStamp;
+	uint64_t numBlocks;
+	infile.read((char*) &storedStamp, sizeof(storedStamp));
+	infile.read((char*) &numBlocks, sizeof(numBlocks));
+	if (!infile.good() || storedStamp != textFileStamp || numBlocks == 0 || (numBlocks & (numBlocks - 1)) != 0) {
+		return false;
+	}
+	words.resize(numBlocks * WORDS_PER_BLOCK);
+	infile.read((char*) words.data(), words.size() * sizeof(uint64_t));
+	if (!infile.good()) {
+		return false;
+	}
+	blockMask = numBlocks - 1;
+	return true;
+}
+
+// The filter is written to a temporary file first, so that a filter other processes are reading is never overwritten.
+void KmerPrefilter::storeFilter(const std::string &filterFile, const TextFileStamp &textFileStamp) {
+	DerivedFileWriter writer(filterFile);
+	std::ofstream &outfile = writer.stream();
+	uint32_t numSizes = kmerSizes.size();
+	uint64_t numBlocks = blockMask + 1;
+	outfile.write(FILTER_MAGIC, sizeof(FILTER_MAGIC));
+	outfile.write((const char*) &numSizes, sizeof(numSizes));
+	for (size_t i = 0; i < numSizes; ++i) {
+		uint32_t k = kmerSizes[i];
+		outfile.write((const char*) &k, sizeof(k));
+	}
+	outfile.write((const char*) &textFileStamp, sizeof(textFileStamp));
+	outfile.write((const char*) &numBlocks, sizeof(numBlocks));
+	outfile.write((const char*) words.data(), words.size() * sizeof(uint64_t));
+	writer.commit();
+}
@@ -0,0 +1,43 @@
+/*
+ * KmerPrefilter.h
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: sarah
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../DerivedFile.h"
+
+/*
+ * A blocked count-min sketch over the canonical k-mers of a few fixed sizes. Every k-mer is mapped to one 64-byte block
+ * of 128 saturating 4-bit counters, and all of its counters lie in that block, so a query touches a single cache line.
+ * The smallest counter of a k-mer is an upper bound of its count (up to the saturation value), which answers
+ * "definitely absent" and "definitely less than T occurrences" without searching the FM index.
+ * It is built in one pass over the same file the FM index is built from (one sequence per line, or FASTQ).
+ */
+class KmerPrefilter {
+public:
+	KmerPrefilter(const std::vector<size_t> &kmerSizes);
+	void buildFromFile(const std::string &filepath, size_t expectedDistinctKmers);
+	bool loadFilter(const std::string &filterFile, const TextFileStamp &textFileStamp);
+	void storeFilter(const std::string &filterFile, const TextFileStamp &textFileStamp);
+	bool coversKmerSize(size_t k) const;
+	bool definitelyAbsent(uint64_t packedKmer, size_t k) const;
+	bool mayOccurAtLeast(uint64_t packedKmer, size_t k, size_t minCount) const;
+	const std::vector<size_t>& getKmerSizes() const;
+	double sizeInMegaBytes() const;
+private:
+	size_t upperBound(uint64_t packedKmer, size_t k) const;
+	void countLine(const std::string &line);
+	void insertCanonical(uint64_t canonical, size_t k);
+
+	std::vector<size_t> kmerSizes;
+	uint64_t blockMask;
+	std::vector<uint64_t> words; // 8 words per block
+};
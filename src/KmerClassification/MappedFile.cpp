@@ -0,0 +1,59 @@
+/*
+ * MappedFile.cpp
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: sarah
+ */
+
+#include "MappedFile.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile() {
+	mapped = NULL;
+	length = 0;
+}
+
+MappedFile::~MappedFile() {
+	close();
+}
+
+bool MappedFile::open(const std::string &filepath) {
+	close();
+	int fd = ::open(filepath.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0) {
+		::close(fd);
+		return false;
+	}
+	void *addr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	::close(fd); // the mapping stays valid without the file descriptor
+	if (addr == MAP_FAILED) {
+		return false;
+	}
+	mapped = (char*) addr;
+	length = st.st_size;
+	return true;
+}
+
+void MappedFile::close() {
+	if (mapped) {
+		munmap(mapped, length);
+		mapped = NULL;
+		length = 0;
+	}
+}
+
+const char* MappedFile::data() const {
+	return mapped;
+}
+
+size_t MappedFile::size() const {
+	return length;
+}
@@ -0,0 +1,31 @@
+/*
+ * MappedFile.h
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: sarah
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <string>
+
+/*
+ * Read-only memory mapping of a whole file. The pages are taken from the page cache, so processes mapping the same
+ * file share them as long as they use the mapped data in place, and nothing is copied into a buffer of their own before
+ * it is accessed.
+ */
+class MappedFile {
+public:
+	MappedFile();
+	~MappedFile();
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	bool open(const std::string &filepath);
+	void close();
+	const char* data() const;
+	size_t size() const;
+private:
+	char *mapped;
+	size_t length;
+};
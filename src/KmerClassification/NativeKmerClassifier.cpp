@@ -0,0 +1,258 @@
+/*
+ * NativeKmerClassifier.cpp
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: sarah
+ */
+
+#include "NativeKmerClassifier.h"
+
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+// the class ids of KmerType, as used by the naive and statistical models of blackbox_kmer.py
+static const int CLASS_REPEAT = 0;
+static const int CLASS_TRUSTED = 1;
+static const int CLASS_UNTRUSTED = 2;
+// the most classes a tree ensemble may have, so that classifying sums up their probabilities on the stack
+static const size_t MAX_TREE_CLASSES = 8;
+
+NativeKmerClassifier::NativeKmerClassifier() {
+	modelType = ModelType::NONE;
+	numFeatures = 0;
+}
+
+bool NativeKmerClassifier::isLoaded() const {
+	return modelType != ModelType::NONE;
+}
+
+static std::istringstream expectLine(std::ifstream &infile, const std::string &keyword) {
+	std::string line;
+	if (!std::getline(infile, line)) {
+		throw std::runtime_error("Unexpected end of the k-mer classifier model, expected " + keyword);
+	}
+	std::istringstream iss(line);
+	std::string word;
+	iss >> word;
+	if (word != keyword) {
+		throw std::runtime_error("Invalid k-mer classifier model, expected " + keyword + " but got: " + line);
+	}
+	return iss;
+}
+
+static std::vector<double> readValues(std::istringstream &iss) {
+	std::vector<double> values;
+	double value;
+	while (iss >> value) {
+		values.push_back(value);
+	}
+	return values;
+}
+
+// Returns false if the file does not exist. Throws if it exists but cannot be parsed.
+bool NativeKmerClassifier::loadModel(const std::string &filename) {
+	std::ifstream infile(filename);
+	if (!infile.good()) {
+		return false;
+	}
+	std::string header;
+	int version;
+	if (!(infile >> header >> version) || header != "paec_kmer_model" || version != 1) {
+		throw std::runtime_error("Unknown k-mer classifier model format: " + filename);
+	}
+	infile.ignore(1, '\n');
+	std::string type;
+	expectLine(infile, "type") >> type;
+
+	modelType = ModelType::NONE;
+	classes.clear();
+	numFeatures = 0;
+	logNormalizedPrior.clear();
+	theta.clear();
+	sigma.clear();
+	coefficients.clear();
+	nodes.clear();
+	roots.clear();
+	leafProbabilities.clear();
+
+	if (type == "naive") {
+		modelType = ModelType::NAIVE;
+		return true;
+	} else if (type == "statistical") {
+		modelType = ModelType::STATISTICAL;
+		return true;
+	}
+
+	std::istringstream classesLine = expectLine(infile, "classes");
+	size_t numClasses;
+	classesLine >> numClasses;
+	classes.resize(numClasses);
+	for (size_t i = 0; i < numClasses; ++i) {
+		classesLine >> classes[i];
+	}
+
+	if (type == "gaussian_nb") {
+		std::istringstream priorLine = expectLine(infile, "prior");
+		std::vector<double> prior = readValues(priorLine);
+		for (size_t i = 0; i < numClasses; ++i) {
+			std::istringstream thetaLine = expectLine(infile, "theta");
+			std::vector<double> thetaRow = readValues(thetaLine);
+			std::istringstream sigmaLine = expectLine(infile, "sigma");
+			std::vector<double> sigmaRow = readValues(sigmaLine);
+			numFeatures = thetaRow.size();
+			// the part of the joint log likelihood that does not depend on the features
+			double normalization = 0;
+			for (size_t j = 0; j < numFeatures; ++j) {
+				normalization += std::log(2. * M_PI * sigmaRow[j]);
+			}
+			logNormalizedPrior.push_back(std::log(prior[i]) - 0.5 * normalization);
+			theta.insert(theta.end(), thetaRow.begin(), thetaRow.end());
+			sigma.insert(sigma.end(), sigmaRow.begin(), sigmaRow.end());
+		}
+		modelType = ModelType::GAUSSIAN_NB;
+	} else if (type == "logistic") {
+		size_t numRows;
+		expectLine(infile, "rows") >> numRows;
+		for (size_t i = 0; i < numRows; ++i) {
+			std::istringstream coefLine = expectLine(infile, "coef");
+			coefficients.push_back(readValues(coefLine));
+		}
+		modelType = ModelType::LOGISTIC;
+	} else if (type == "tree_ensemble") {
+		if (numClasses > MAX_TREE_CLASSES) {
+			throw std::runtime_error("The k-mer classifier model has more classes than supported: " + filename);
+		}
+		size_t numTrees;
+		expectLine(infile, "trees") >> numTrees;
+		for (size_t t = 0; t < numTrees; ++t) {
+			size_t numNodes;
+			expectLine(infile, "nodes") >> numNodes;
+			int32_t offset = nodes.size();
+			roots.push_back(offset);
+			for (size_t i = 0; i < numNodes; ++i) {
+				std::string line;
+				if (!std::getline(infile, line)) {
+					throw std::runtime_error("Unexpected end of the k-mer classifier model: " + filename);
+				}
+				std::istringstream iss(line);
+				std::string kind;
+				iss >> kind;
+				TreeNode node;
+				if (kind == "leaf") {
+					node.feature = -1;
+					node.threshold = 0;
+					node.child[0] = leafProbabilities.size();
+					node.child[1] = node.child[0];
+					std::vector<double> proba = readValues(iss);
+					if (proba.size() != numClasses) {
+						throw std::runtime_error("Invalid leaf in the k-mer classifier model: " + line);
+					}
+					leafProbabilities.insert(leafProbabilities.end(), proba.begin(), proba.end());
+				} else if (kind == "split") {
+					iss >> node.feature >> node.threshold >> node.child[0] >> node.child[1];
+					node.child[0] += offset;
+					node.child[1] += offset;
+				} else {
+					throw std::runtime_error("Invalid node in the k-mer classifier model: " + line);
+				}
+				nodes.push_back(node);
+			}
+		}
+		modelType = ModelType::TREE_ENSEMBLE;
+	} else {
+		throw std::runtime_error("Unknown k-mer classifier model type: " + type);
+	}
+	return true;
+}
+
+// the features are ZScore, gcContent, size, observedCount, biasCorrectedObservedCount, expectedCountPusm
+int NativeKmerClassifier::classify(const std::vector<double> &features) const {
+	switch (modelType) {
+	case ModelType::NAIVE:
+		if (features[4] < 0.5 * features[5]) {
+			return CLASS_UNTRUSTED;
+		} else if (features[4] > 1.5 * features[5]) {
+			return CLASS_REPEAT;
+		}
+		return CLASS_TRUSTED;
+	case ModelType::STATISTICAL:
+		if (features[0] < -2) {
+			return CLASS_UNTRUSTED;
+		} else if (features[0] > 2) {
+			return CLASS_REPEAT;
+		}
+		return CLASS_TRUSTED;
+	case ModelType::GAUSSIAN_NB:
+		return classifyGaussianNB(features);
+	case ModelType::LOGISTIC:
+		return classifyLogistic(features);
+	case ModelType::TREE_ENSEMBLE:
+		return classifyTrees(features);
+	default:
+		throw std::runtime_error("No native k-mer classifier model has been loaded!");
+	}
+}
+
+int NativeKmerClassifier::classifyGaussianNB(const std::vector<double> &features) const {
+	size_t best = 0;
+	double bestLikelihood = 0;
+	for (size_t i = 0; i < classes.size(); ++i) {
+		double sum = 0;
+		for (size_t j = 0; j < numFeatures; ++j) {
+			double diff = features[j] - theta[i * numFeatures + j];
+			sum += diff * diff / sigma[i * numFeatures + j];
+		}
+		double likelihood = logNormalizedPrior[i] - 0.5 * sum;
+		if (i == 0 || likelihood > bestLikelihood) {
+			best = i;
+			bestLikelihood = likelihood;
+		}
+	}
+	return classes[best];
+}
+
+int NativeKmerClassifier::classifyLogistic(const std::vector<double> &features) const {
+	size_t best = 0;
+	double bestScore = 0;
+	for (size_t i = 0; i < coefficients.size(); ++i) {
+		double score = coefficients[i][0];
+		for (size_t j = 1; j < coefficients[i].size(); ++j) {
+			score += coefficients[i][j] * features[j - 1];
+		}
+		if (coefficients.size() == 1) { // binary problem, the row belongs to the second class
+			return classes[score > 0 ? 1 : 0];
+		}
+		if (i == 0 || score > bestScore) {
+			best = i;
+			bestScore = score;
+		}
+	}
+	return classes[best];
+}
+
+// sklearn compares single-precision features with the thresholds, and averages the leaf probabilities of all trees.
+// Nothing is allocated, so that classifying threads do not contend for the heap.
+int NativeKmerClassifier::classifyTrees(const std::vector<double> &features) const {
+	size_t numClasses = classes.size();
+	double probabilities[MAX_TREE_CLASSES] = { };
+	for (int32_t root : roots) {
+		int32_t node = root;
+		while (nodes[node].feature >= 0) {
+			const TreeNode &split = nodes[node];
+			node = split.child[(float) features[split.feature] > split.threshold];
+		}
+		const double *leaf = &leafProbabilities[nodes[node].child[0]];
+		for (size_t c = 0; c < numClasses; ++c) {
+			probabilities[c] += leaf[c];
+		}
+	}
+	size_t best = 0;
+	for (size_t c = 1; c < numClasses; ++c) {
+		if (probabilities[c] > probabilities[best]) {
+			best = c;
+		}
+	}
+	return classes[best];
+}
@@ -0,0 +1,54 @@
+/*
+ * NativeKmerClassifier.h
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: sarah
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+ * Evaluates the k-mer classifier chosen by blackbox_kmer.py in C++, from the file written by its export_model().
+ * It returns the same class ids as the Python model for the naive and statistical rules, Gaussian naive Bayes,
+ * logistic regression, and single decision trees and random forests. classify() is const and thread-safe.
+ * The nodes of all trees are stored in one array, and a split picks its child by indexing with the comparison result
+ * instead of branching on it.
+ */
+class NativeKmerClassifier {
+public:
+	NativeKmerClassifier();
+	bool loadModel(const std::string &filename);
+	bool isLoaded() const;
+	int classify(const std::vector<double> &features) const;
+private:
+	enum class ModelType {
+		NONE, NAIVE, STATISTICAL, GAUSSIAN_NB, LOGISTIC, TREE_ENSEMBLE
+	};
+	struct TreeNode {
+		double threshold;
+		int32_t feature; // -1 for a leaf
+		int32_t child[2]; // left (feature <= threshold) and right child; for a leaf, child[0] indexes its probabilities
+	};
+	int classifyGaussianNB(const std::vector<double> &features) const;
+	int classifyLogistic(const std::vector<double> &features) const;
+	int classifyTrees(const std::vector<double> &features) const;
+
+	ModelType modelType;
+	std::vector<int> classes;
+	size_t numFeatures;
+	// GaussianNB: log prior and normalization term per class, theta and sigma per class and feature
+	std::vector<double> logNormalizedPrior;
+	std::vector<double> theta;
+	std::vector<double> sigma;
+	// LogisticRegression: one row of intercept and coefficients per class, or a single row for two classes
+	std::vector<std::vector<double> > coefficients;
+	// tree ensembles
+	std::vector<TreeNode> nodes;
+	std::vector<int32_t> roots;
+	std::vector<double> leafProbabilities;
+};
@@ -0,0 +1,90 @@
+/*
+ * PackedKmer.h
+ * 2-bit encoding of k-mers over {A,C,G,T} with k <= 31, used as key for the fixed-size k-mer tables.
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: sarah
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+static const size_t MAX_PACKED_KMER_SIZE = 31;
+
+// returns 0..3 for A, C, G, T and 4 for every other character
+inline uint64_t packBase(char base) {
+	switch (base) {
+	case 'A':
+		return 0;
+	case 'C':
+		return 1;
+	case 'G':
+		return 2;
+	case 'T':
+		return 3;
+	default:
+		return 4;
+	}
+}
+
+inline char unpackBase(uint64_t code) {
+	static const char bases[4] = { 'A', 'C', 'G', 'T' };
+	return bases[code & 3];
+}
+
+inline uint64_t packedKmerMask(size_t k) {
+	return (k >= 32) ? ~0ULL : ((1ULL << (2 * k)) - 1);
+}
+
+// returns false if the k-mer is too long or contains a character other than A, C, G, T
+inline bool packKmer(const std::string &kmer, uint64_t &packed) {
+	if (kmer.size() > MAX_PACKED_KMER_SIZE) {
+		return false;
+	}
+	packed = 0;
+	for (size_t i = 0; i < kmer.size(); ++i) {
+		uint64_t code = packBase(kmer[i]);
+		if (code > 3) {
+			return false;
+		}
+		packed = (packed << 2) | code;
+	}
+	return true;
+}
+
+inline std::string unpackKmer(uint64_t packed, size_t k) {
+	std::string kmer(k, 'A');
+	for (size_t i = k; i > 0; --i) {
+		kmer[i - 1] = unpackBase(packed);
+		packed >>= 2;
+	}
+	return kmer;
+}
+
+inline uint64_t reverseComplementPacked(uint64_t packed, size_t k) {
+	uint64_t rc = 0;
+	for (size_t i = 0; i < k; ++i) {
+		rc = (rc << 2) | (3 - (packed & 3));
+		packed >>= 2;
+	}
+	return rc;
+}
+
+// the smaller one of the k-mer and its reverse complement
+inline uint64_t canonicalPacked(uint64_t packed, size_t k) {
+	uint64_t rc = reverseComplementPacked(packed, k);
+	return (rc < packed) ? rc : packed;
+}
+
+// finalizer of splitmix64, spreads the packed k-mers evenly over the slots of a hash table
+inline uint64_t hashPacked(uint64_t packed) {
+	packed ^= packed >> 30;
+	packed *= 0xbf58476d1ce4e5b9ULL;
+	packed ^= packed >> 27;
+	packed *= 0x94d049bb133111ebULL;
+	packed ^= packed >> 31;
+	return packed;
+}
@@ -0,0 +1,131 @@
+/*
+ * ReferenceKmerTable.cpp
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: sarah
+ */
+
+#include "ReferenceKmerTable.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "PackedKmer.h"
+
+// the multiplicity of a valid entry is at most 2, so this never is a valid entry
+static const uint64_t EMPTY_ENTRY = ~0ULL;
+static const uint64_t MAX_MULTIPLICITY = 2;
+// number of genome positions whose windows are inserted by one thread at a time
+static const size_t POSITIONS_PER_BLOCK = 1 << 16;
+
+ReferenceKmerTable::ReferenceKmerTable(const std::vector<size_t> &kmerSizes) {
+	for (size_t k : kmerSizes) {
+		if (k == 0 || k > MAX_PACKED_KMER_SIZE) {
+			throw std::runtime_error("Reference k-mer tables only support k-mer sizes from 1 to 31!");
+		}
+		if (!coversKmerSize(k)) {
+			SizeTable table;
+			table.k = k;
+			table.slotMask = 0;
+			table.entries.assign(1, EMPTY_ENTRY);
+			tables.push_back(table);
+		}
+	}
+}
+
+const ReferenceKmerTable::SizeTable* ReferenceKmerTable::tableOf(size_t k) const {
+	for (const SizeTable &table : tables) {
+		if (table.k == k) {
+			return &table;
+		}
+	}
+	return NULL;
+}
+
+bool ReferenceKmerTable::coversKmerSize(size_t k) const {
+	return tableOf(k) != NULL;
+}
+
+double ReferenceKmerTable::sizeInMegaBytes() const {
+	size_t numEntries = 0;
+	for (const SizeTable &table : tables) {
+		numEntries += table.entries.size();
+	}
+	return numEntries * sizeof(uint64_t) / (1024.0 * 1024.0);
+}
+
+// Thread-safe. The multiplicity saturates at 2.
+void ReferenceKmerTable::insertCanonical(SizeTable &table, uint64_t canonical, uint64_t occurrences) {
+	size_t slot = hashPacked(canonical) & table.slotMask;
+	while (true) {
+		uint64_t entry = __atomic_load_n(&table.entries[slot], __ATOMIC_RELAXED);
+		if (entry == EMPTY_ENTRY) {
+			uint64_t newEntry = (canonical << 2) | std::min(occurrences, MAX_MULTIPLICITY);
+			if (__atomic_compare_exchange_n(&table.entries[slot], &entry, newEntry, false, __ATOMIC_RELAXED,
+					__ATOMIC_RELAXED)) {
+				return;
+			} // otherwise entry now holds the k-mer another thread has put there
+		}
+		while ((entry >> 2) == canonical) {
+			uint64_t multiplicity = std::min((entry & 3) + occurrences, MAX_MULTIPLICITY);
+			if ((entry & 3) == multiplicity || __atomic_compare_exchange_n(&table.entries[slot], &entry,
+					(canonical << 2) | multiplicity, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+				return;
+			}
+		}
+		slot = (slot + 1) & table.slotMask;
+	}
+}
+
+// Inserts every window of the genome that consists of A, C, G and T only. The genome is split into blocks of
+// positions that are inserted in parallel, every block starts k - 1 positions early to fill its window.
+void ReferenceKmerTable::build(const std::string &genome) {
+	size_t numBlocks = (genome.size() + POSITIONS_PER_BLOCK - 1) / POSITIONS_PER_BLOCK;
+	for (SizeTable &table : tables) {
+		size_t k = table.k;
+		size_t capacity = 1;
+		while (genome.size() > 0.7 * capacity) { // every window could be a different k-mer
+			capacity *= 2;
+		}
+		table.entries.assign(capacity, EMPTY_ENTRY);
+		table.slotMask = capacity - 1;
+		uint64_t mask = packedKmerMask(k);
+		size_t shift = 2 * (k - 1);
+#pragma omp parallel for schedule(dynamic, 1)
+		for (size_t b = 0; b < numBlocks; ++b) {
+			size_t blockEnd = std::min(genome.size(), (b + 1) * POSITIONS_PER_BLOCK);
+			size_t i = (b * POSITIONS_PER_BLOCK >= k - 1) ? b * POSITIONS_PER_BLOCK - (k - 1) : 0;
+			uint64_t fwd = 0;
+			uint64_t rc = 0;
+			size_t numValid = 0;
+			for (; i < blockEnd; ++i) {
+				uint64_t code = packBase(genome[i]);
+				if (code > 3) {
+					numValid = 0;
+					continue;
+				}
+				fwd = ((fwd << 2) | code) & mask;
+				rc = (rc >> 2) | ((3 - code) << shift);
+				numValid++;
+				if (numValid >= k && i >= b * POSITIONS_PER_BLOCK) {
+					// a palindromic window is an occurrence of the k-mer and of its reverse complement
+					insertCanonical(table, std::min(fwd, rc), (fwd == rc) ? 2 : 1);
+				}
+			}
+		}
+	}
+}
+
+// 0, 1 or 2 for at least two occurrences. The table has to cover the k-mer size.
+size_t ReferenceKmerTable::multiplicity(uint64_t packedKmer, size_t k) const {
+	const SizeTable *table = tableOf(k);
+	uint64_t canonical = canonicalPacked(packedKmer, k);
+	size_t slot = hashPacked(canonical) & table->slotMask;
+	while (table->entries[slot] != EMPTY_ENTRY) {
+		if ((table->entries[slot] >> 2) == canonical) {
+			return table->entries[slot] & 3;
+		}
+		slot = (slot + 1) & table->slotMask;
+	}
+	return 0;
+}
@@ -0,0 +1,39 @@
+/*
+ * ReferenceKmerTable.h
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: sarah
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+ * The multiplicity class (0, 1 or at least 2) of every canonical k-mer of a reference genome, for a few fixed k-mer
+ * sizes. Every entry packs the canonical k-mer and its 2-bit multiplicity into a single word of an open addressing
+ * hash table, so a query costs one probe. The multiplicities are those of KmerCounter::countKmer on an index of the
+ * genome: occurrences of the k-mer plus occurrences of its reverse complement.
+ * Meant for small genomes, where all of its k-mers fit into memory easily.
+ */
+class ReferenceKmerTable {
+public:
+	ReferenceKmerTable(const std::vector<size_t> &kmerSizes);
+	void build(const std::string &genome);
+	bool coversKmerSize(size_t k) const;
+	size_t multiplicity(uint64_t packedKmer, size_t k) const;
+	double sizeInMegaBytes() const;
+private:
+	struct SizeTable {
+		size_t k;
+		uint64_t slotMask;
+		std::vector<uint64_t> entries; // canonical k-mer shifted left by 2, or'ed with its multiplicity
+	};
+	static void insertCanonical(SizeTable &table, uint64_t canonical, uint64_t occurrences);
+	const SizeTable* tableOf(size_t k) const;
+
+	std::vector<SizeTable> tables;
+};
@@ -0,0 +1,101 @@
+/*
+ * SolidKmerGraph.cpp
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: sarah
+ */
+
+#include "SolidKmerGraph.h"
+
+#include "PackedKmer.h"
+
+// the mask of the complementary bases, i.e. with bit b moved to bit 3 - b
+static inline uint8_t complementBases(uint8_t bases) {
+	return ((bases & 1) << 3) | ((bases & 2) << 1) | ((bases & 4) >> 1) | ((bases & 8) >> 3);
+}
+
+SolidKmerGraph::SolidKmerGraph(const KmerCountTable &countTable) :
+		countTable(countTable) {
+	numNodes = 0;
+}
+
+size_t SolidKmerGraph::getKmerSize() const {
+	return countTable.getKmerSize();
+}
+
+size_t SolidKmerGraph::getNumNodes() const {
+	return numNodes;
+}
+
+double SolidKmerGraph::sizeInMegaBytes() const {
+	return (solid.size() + edges.size()) / (1024.0 * 1024.0);
+}
+
+// Marks the solid k-mers first and connects them afterwards, both on all threads if parallel is set, so isSolidKmer
+// has to be thread-safe then.
+void SolidKmerGraph::build(const std::function<bool(uint64_t canonical, size_t count)> &isSolidKmer, bool parallel) {
+	size_t numSlots = countTable.getNumSlots();
+	size_t k = countTable.getKmerSize();
+	uint64_t mask = packedKmerMask(k);
+	solid.assign(numSlots, 0);
+	edges.assign(numSlots, 0);
+	size_t solidNodes = 0;
+#pragma omp parallel for schedule(dynamic, 4096) reduction(+:solidNodes) if (parallel)
+	for (size_t slot = 0; slot < numSlots; ++slot) {
+		uint64_t canonical;
+		if (countTable.kmerInSlot(slot, canonical) && isSolidKmer(canonical, countTable.countKmer(canonical))) {
+			solid[slot] = 1;
+			solidNodes++;
+		}
+	}
+	numNodes = solidNodes;
+#pragma omp parallel for schedule(dynamic, 4096) if (parallel)
+	for (size_t slot = 0; slot < numSlots; ++slot) {
+		uint64_t canonical;
+		if (!solid[slot] || !countTable.kmerInSlot(slot, canonical)) {
+			continue;
+		}
+		uint8_t nodeEdges = 0;
+		for (uint64_t base = 0; base < 4; ++base) {
+			if (isSolid(((canonical << 2) | base) & mask)) {
+				nodeEdges |= 1 << base;
+			}
+			if (isSolid((base << (2 * (k - 1))) | (canonical >> 2))) {
+				nodeEdges |= 16 << base;
+			}
+		}
+		edges[slot] = nodeEdges;
+	}
+}
+
+bool SolidKmerGraph::findNode(uint64_t packedKmer, size_t &slot) const {
+	return countTable.findKmer(packedKmer, slot) && solid[slot];
+}
+
+bool SolidKmerGraph::isSolid(uint64_t packedKmer) const {
+	size_t slot;
+	return findNode(packedKmer, slot);
+}
+
+uint8_t SolidKmerGraph::successors(uint64_t packedKmer) const {
+	size_t slot;
+	if (!findNode(packedKmer, slot)) {
+		return 0;
+	}
+	if (packedKmer <= reverseComplementPacked(packedKmer, countTable.getKmerSize())) {
+		return edges[slot] & 15;
+	}
+	// appending b to the k-mer means prepending the complement of b to its reverse complement
+	return complementBases(edges[slot] >> 4);
+}
+
+uint8_t SolidKmerGraph::predecessors(uint64_t packedKmer) const {
+	size_t slot;
+	if (!findNode(packedKmer, slot)) {
+		return 0;
+	}
+	if (packedKmer <= reverseComplementPacked(packedKmer, countTable.getKmerSize())) {
+		return edges[slot] >> 4;
+	}
+	return complementBases(edges[slot] & 15);
+}
@@ -0,0 +1,41 @@
+/*
+ * SolidKmerGraph.h
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: sarah
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "KmerCountTable.h"
+
+/*
+ * The de Bruijn graph of the solid k-mers of the reads, i.e. of the distinct k-mers of a KmerCountTable that are not
+ * untrusted. Like KmerClassTable, it has no keys of its own but stores a flag and a byte of edges per slot of the count
+ * table: the low 4 bits mark the bases that can be appended to the canonical k-mer, the high 4 bits the bases that can
+ * be prepended to it, such that the result is solid again. A k-mer and its reverse complement are the same node, so
+ * the edges of the other strand are the complemented edges of the opposite end.
+ */
+class SolidKmerGraph {
+public:
+	SolidKmerGraph(const KmerCountTable &countTable);
+	void build(const std::function<bool(uint64_t canonical, size_t count)> &isSolidKmer, bool parallel);
+	bool isSolid(uint64_t packedKmer) const;
+	uint8_t successors(uint64_t packedKmer) const; // bit b is set if appending base b gives a solid k-mer
+	uint8_t predecessors(uint64_t packedKmer) const; // bit b is set if prepending base b gives a solid k-mer
+	size_t getKmerSize() const;
+	size_t getNumNodes() const;
+	double sizeInMegaBytes() const;
+private:
+	bool findNode(uint64_t packedKmer, size_t &slot) const;
+
+	const KmerCountTable &countTable;
+	std::vector<uint8_t> solid; // per slot of the count table
+	std::vector<uint8_t> edges; // per slot of the count table
+	size_t numNodes;
+};
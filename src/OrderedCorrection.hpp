@@ -0,0 +1,163 @@
+/*
+ * OrderedCorrection.hpp
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: sarah
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <algorithm>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ErrorProfile/ErrorProfileUnit.hpp"
+#include "ReorderBuffer.hpp"
+#include "WorkStealingPool.hpp"
+
+// The reads are corrected in tasks of consecutive reads, which shrink towards the end of a file so that the workers
+// finish at about the same time: every worker should get this many more tasks, of at least MIN_READS_PER_TASK and at
+// most MAX_READS_PER_TASK reads.
+static const size_t TASKS_PER_WORKER = 16;
+static const size_t MIN_READS_PER_TASK = 4;
+static const size_t MAX_READS_PER_TASK = 64;
+// a worker that runs out of tasks reads at most this many new ones at once, the others can steal them
+static const size_t TASKS_PER_REFILL = 4;
+// Every worker may run this many tasks ahead of the first task that has not been written yet.
+static const size_t PENDING_TASKS_PER_WORKER = 8;
+
+/*
+ * Splits the observers of a correction into the profiles that can be merged, which every thread checks the reads into
+ * an accumulator of its own for, and the other ones, which have to check the reads in their order in a single thread.
+ */
+class ObserverAccumulators {
+public:
+	ObserverAccumulators(const std::vector<ErrorProfileUnit*> &observers, size_t numThreads) :
+			accumulators(numThreads) {
+		for (ErrorProfileUnit *observer : observers) {
+			std::unique_ptr<ErrorProfileUnit> accumulator = observer->createAccumulator();
+			if (accumulator) {
+				mergedObservers.push_back(observer);
+				accumulators[0].push_back(std::move(accumulator));
+				for (size_t t = 1; t < numThreads; ++t) {
+					accumulators[t].push_back(observer->createAccumulator());
+				}
+			} else {
+				orderedObservers.push_back(observer);
+			}
+		}
+	}
+
+	std::vector<std::unique_ptr<ErrorProfileUnit> >& ofThread(size_t threadId) {
+		return accumulators[threadId];
+	}
+
+	const std::vector<ErrorProfileUnit*>& getOrderedObservers() const {
+		return orderedObservers;
+	}
+
+	// has to be called once all reads have been checked, before the observers are finalized
+	void mergeIntoObservers() {
+		for (size_t j = 0; j < mergedObservers.size(); ++j) {
+			for (size_t t = 0; t < accumulators.size(); ++t) {
+				mergedObservers[j]->mergeAccumulator(*accumulators[t][j]);
+			}
+		}
+	}
+private:
+	std::vector<ErrorProfileUnit*> mergedObservers;
+	std::vector<ErrorProfileUnit*> orderedObservers;
+	std::vector<std::vector<std::unique_ptr<ErrorProfileUnit> > > accumulators; // by thread, then by merged observer
+};
+
+/*
+ * Corrects the reads of a file iterator on a work-stealing pool. Its workers correct tasks of consecutive reads by
+ * correctBatch, which also gets the id of the worker, and put the results into a reorder buffer, from which the calling
+ * thread hands them to writeBatch in the order of the file and prints the progress from firstProgress percent on.
+ * The workers only read new tasks if the buffer has room for them, so a slow task holds back at most
+ * PENDING_TASKS_PER_WORKER * numThreads tasks. If given, readBatch gets the reads of every task as soon as they are
+ * read, in the order of the file, before they are corrected. Rethrows the first exception of a worker or of writeBatch.
+ */
+template<class Read, class Batch, class Iterator>
+void correctInFileOrder(Iterator &iterator, size_t numThreads, const std::string &name, double firstProgress,
+		const std::function<void(const std::vector<Read>&, Batch&, size_t)> &correctBatch,
+		const std::function<void(Batch&)> &writeBatch,
+		const std::function<void(const std::vector<Read>&)> &readBatch = nullptr) {
+	// consecutive reads of the file, in the order of the file
+	struct ReadTask {
+		size_t batchId;
+		std::vector<Read> reads;
+		double progress;
+	};
+	struct CorrectedTask {
+		Batch batch;
+		double progress;
+	};
+	ReorderBuffer<CorrectedTask> reorderBuffer(PENDING_TASKS_PER_WORKER * numThreads);
+
+	auto refill = [&](std::vector<ReadTask> &tasks, size_t workerId) {
+		try {
+			size_t room = reorderBuffer.waitForRoom();
+			size_t readsPerTask = std::min(MAX_READS_PER_TASK,
+					std::max(MIN_READS_PER_TASK, iterator.numReadsLeft() / (numThreads * TASKS_PER_WORKER)));
+			for (size_t i = 0; i < std::min(room, TASKS_PER_REFILL) && iterator.hasReadsLeft(); ++i) {
+				ReadTask task;
+				task.batchId = reorderBuffer.issueId();
+				task.reads = iterator.next(readsPerTask);
+				if (readBatch) {
+					readBatch(task.reads);
+				}
+				task.progress = iterator.progress();
+				tasks.push_back(std::move(task));
+			}
+			if (!iterator.hasReadsLeft()) {
+				reorderBuffer.close();
+			}
+			return room > 0 && iterator.hasReadsLeft();
+		} catch (...) {
+			reorderBuffer.abort();
+			throw;
+		}
+	};
+	auto process = [&](ReadTask &task, size_t workerId) {
+		try {
+			CorrectedTask corrected;
+			corrected.progress = task.progress;
+			correctBatch(task.reads, corrected.batch, workerId);
+			reorderBuffer.put(task.batchId, std::move(corrected));
+		} catch (...) {
+			reorderBuffer.abort();
+			throw;
+		}
+	};
+	WorkStealingPool<ReadTask> pool(numThreads, refill, process);
+	pool.start();
+
+	std::exception_ptr writerError;
+	try {
+		double minProgress = firstProgress;
+		CorrectedTask corrected;
+		while (reorderBuffer.takeNext(corrected)) {
+			writeBatch(corrected.batch);
+			if (corrected.progress >= minProgress) {
+				std::cout << corrected.progress << " \%" << std::endl;
+				while (corrected.progress >= minProgress) {
+					minProgress += 1;
+				}
+			}
+		}
+	} catch (...) {
+		writerError = std::current_exception();
+		reorderBuffer.abort();
+	}
+	pool.join();
+	if (writerError) {
+		std::rethrow_exception(writerError);
+	}
+	pool.printStatistics(name);
+}
@@ -0,0 +1,98 @@
+/*
+ * ReorderBuffer.hpp
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: sarah
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+
+/*
+ * Returns results that are produced out of order in the order of their consecutive ids. The ids are issued by a single
+ * producer, and at most maxPending results may wait for an earlier one: further ids are only issued once there is room.
+ * After abort(), all waiting calls return and further results are dropped.
+ */
+template<class T> class ReorderBuffer {
+public:
+	ReorderBuffer(size_t maxPending);
+	size_t waitForRoom(); // the number of ids that can be issued, 0 if aborted
+	size_t issueId();
+	void close(); // no more ids will be issued
+	void put(size_t id, T &&result);
+	bool takeNext(T &result); // false once all results have been taken or if aborted
+	void abort();
+private:
+	std::mutex mtx;
+	std::condition_variable cvRoom, cvNext;
+	std::map<size_t, T> pending;
+	size_t maxPending;
+	size_t numIssued;
+	size_t numTaken;
+	bool closed;
+	bool aborted;
+};
+
+template<class T> ReorderBuffer<T>::ReorderBuffer(size_t maxPending) {
+	this->maxPending = maxPending;
+	numIssued = 0;
+	numTaken = 0;
+	closed = false;
+	aborted = false;
+}
+
+template<class T> size_t ReorderBuffer<T>::waitForRoom() {
+	std::unique_lock<std::mutex> lck(mtx);
+	cvRoom.wait(lck, [this] {return aborted || numIssued < numTaken + maxPending;});
+	return aborted ? 0 : numTaken + maxPending - numIssued;
+}
+
+template<class T> size_t ReorderBuffer<T>::issueId() {
+	std::lock_guard<std::mutex> lck(mtx);
+	return numIssued++;
+}
+
+template<class T> void ReorderBuffer<T>::close() {
+	std::lock_guard<std::mutex> lck(mtx);
+	closed = true;
+	cvNext.notify_all();
+}
+
+template<class T> void ReorderBuffer<T>::put(size_t id, T &&result) {
+	std::lock_guard<std::mutex> lck(mtx);
+	if (aborted) {
+		return;
+	}
+	pending.emplace(id, std::move(result));
+	if (id == numTaken) {
+		cvNext.notify_all();
+	}
+}
+
+template<class T> bool ReorderBuffer<T>::takeNext(T &result) {
+	std::unique_lock<std::mutex> lck(mtx);
+	cvNext.wait(lck, [this] {
+		return aborted || pending.count(numTaken) > 0 || (closed && numTaken == numIssued);
+	});
+	auto it = pending.find(numTaken);
+	if (aborted || it == pending.end()) {
+		return false;
+	}
+	result = std::move(it->second);
+	pending.erase(it);
+	numTaken++;
+	cvRoom.notify_all();
+	return true;
+}
+
+template<class T> void ReorderBuffer<T>::abort() {
+	std::lock_guard<std::mutex> lck(mtx);
+	aborted = true;
+	pending.clear();
+	cvRoom.notify_all();
+	cvNext.notify_all();
+}
@@ -0,0 +1,99 @@
+/*
+ * SequenceLineReader.cpp
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: sarah
+ */
+
+#include "SequenceLineReader.h"
+
+#include <fstream>
+#include <stdexcept>
+
+#include "DerivedFile.h"
+
+SequenceLineReader::SequenceLineReader(const std::string &filepath) {
+	file = gzopen(filepath.c_str(), "rb"); // reads uncompressed files as they are
+	if (!file) {
+		throw std::runtime_error("This file does not exist! " + filepath);
+	}
+	gzbuffer(file, 1 << 20);
+	hasPendingLine = readRawLine(pendingLine);
+	fastq = hasPendingLine && !pendingLine.empty() && pendingLine[0] == '@';
+}
+
+SequenceLineReader::~SequenceLineReader() {
+	gzclose(file);
+}
+
+bool SequenceLineReader::isFastq() const {
+	return fastq;
+}
+
+bool SequenceLineReader::isFastqFile(const std::string &filepath) {
+	SequenceLineReader reader(filepath);
+	return reader.isFastq();
+}
+
+// reads the next line without its line break, returns false at the end of the file
+bool SequenceLineReader::readRawLine(std::string &line) {
+	if (hasPendingLine) {
+		line.swap(pendingLine);
+		hasPendingLine = false;
+		return true;
+	}
+	line.clear();
+	char buffer[1 << 16];
+	while (gzgets(file, buffer, sizeof(buffer))) {
+		line += buffer;
+		if (!line.empty() && line[line.size() - 1] == '\n') {
+			line.pop_back();
+			return true;
+		}
+	}
+	return !line.empty(); // the last line may lack a line break
+}
+
+// In a FASTQ file, every record consists of four lines of which only the second one is returned.
+bool SequenceLineReader::nextLine(std::string &line) {
+	if (!fastq) {
+		return readRawLine(line);
+	}
+	std::string skipped;
+	if (!readRawLine(skipped)) { // header
+		return false;
+	}
+	if (!readRawLine(line)) {
+		throw std::runtime_error("Truncated FASTQ record: " + skipped);
+	}
+	if (!line.empty() && line[line.size() - 1] == '\r') {
+		line.pop_back();
+	}
+	readRawLine(skipped); // separator
+	readRawLine(skipped); // quality scores
+	return true;
+}
+
+bool loadReadLengths(const std::string &readsFile, std::unordered_map<size_t, size_t> &readLengths) {
+	std::ifstream infile(readsFile + ".readLengths.txt");
+	TextFileStamp storedStamp;
+	if (!(infile >> storedStamp.size >> storedStamp.mtimeNanos) || storedStamp != stampOfFile(readsFile)) {
+		return false;
+	}
+	readLengths.clear();
+	size_t length, count;
+	while (infile >> length >> count) {
+		readLengths[length] = count;
+	}
+	return true;
+}
+
+void storeReadLengths(const std::string &readsFile, const std::unordered_map<size_t, size_t> &readLengths) {
+	DerivedFileWriter writer(readsFile + ".readLengths.txt");
+	TextFileStamp stamp = stampOfFile(readsFile);
+	writer.stream() << stamp.size << " " << stamp.mtimeNanos << "\n";
+	for (auto kv : readLengths) {
+		writer.stream() << kv.first << " " << kv.second << "\n";
+	}
+	writer.commit();
+}
@@ -0,0 +1,41 @@
+/*
+ * SequenceLineReader.h
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: sarah
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <zlib.h>
+
+/*
+ * Streams the lines of a text file, or only the sequence lines of a FASTQ file, in one pass. Files may be gzip-compressed.
+ * This lets the k-mer indexes be built from the reads file itself instead of a separate text file holding one read per
+ * line.
+ */
+class SequenceLineReader {
+public:
+	SequenceLineReader(const std::string &filepath);
+	~SequenceLineReader();
+	SequenceLineReader(const SequenceLineReader&) = delete;
+	SequenceLineReader& operator=(const SequenceLineReader&) = delete;
+	bool nextLine(std::string &line);
+	bool isFastq() const;
+	static bool isFastqFile(const std::string &filepath);
+private:
+	bool readRawLine(std::string &line);
+
+	gzFile file;
+	bool fastq;
+	bool hasPendingLine;
+	std::string pendingLine;
+};
+
+// The read-length histogram of a reads file, stored next to it and tied to its size and modification time.
+bool loadReadLengths(const std::string &readsFile, std::unordered_map<size_t, size_t> &readLengths);
+void storeReadLengths(const std::string &readsFile, const std::unordered_map<size_t, size_t> &readLengths);
@@ -0,0 +1,213 @@
+/*
+ * WorkStealingPool.hpp
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: sarah
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+ * Runs tasks of very different cost on a fixed number of workers. Every worker has its own deque of tasks and takes
+ * them from its front. Once it is empty, the worker steals a task from the back of the deque of another worker, and
+ * only if there is nothing to steal, it refills its deque from the source of the tasks, one worker at a time.
+ * The pool is finished once the source is exhausted and all deques are empty, as tasks do not create new tasks.
+ * A worker is busy while it processes a task, and idle for the rest of its running time, which includes refilling.
+ */
+template<class T> class WorkStealingPool {
+public:
+	// refill appends new tasks to the vector and returns false if the source is exhausted after them,
+	// process processes one task, both get the id of the calling worker
+	WorkStealingPool(size_t numWorkers, std::function<bool(std::vector<T>&, size_t)> refill,
+			std::function<void(T&, size_t)> process);
+	void start();
+	void join(); // rethrows the first exception of a worker
+	size_t getNumWorkers() const;
+	double getBusySeconds(size_t workerId) const;
+	double getIdleSeconds(size_t workerId) const;
+	size_t getNumTasks(size_t workerId) const;
+	size_t getNumStolenTasks(size_t workerId) const;
+	void printStatistics(const std::string &name) const;
+private:
+	struct Worker {
+		std::mutex mtx;
+		std::deque<T> tasks;
+		double busySeconds = 0;
+		double idleSeconds = 0;
+		size_t numTasks = 0;
+		size_t numStolenTasks = 0;
+	};
+	void work(size_t workerId);
+	bool popOwn(size_t workerId, T &task);
+	bool steal(size_t workerId, T &task);
+	bool refillOwn(size_t workerId, T &task);
+
+	std::function<bool(std::vector<T>&, size_t)> refillTasks;
+	std::function<void(T&, size_t)> processTask;
+
+	std::vector<std::unique_ptr<Worker> > workers;
+	std::vector<std::thread> threads;
+	std::mutex refillMtx;
+	bool sourceExhausted; // guarded by refillMtx
+	std::atomic<bool> stopped;
+	std::mutex errorMtx;
+	std::exception_ptr error;
+};
+
+template<class T> WorkStealingPool<T>::WorkStealingPool(size_t numWorkers,
+		std::function<bool(std::vector<T>&, size_t)> refill, std::function<void(T&, size_t)> process) {
+	refillTasks = refill;
+	processTask = process;
+	for (size_t i = 0; i < std::max(numWorkers, (size_t) 1); ++i) {
+		workers.push_back(std::unique_ptr<Worker>(new Worker()));
+	}
+	sourceExhausted = false;
+	stopped = false;
+}
+
+template<class T> void WorkStealingPool<T>::start() {
+	for (size_t i = 0; i < workers.size(); ++i) {
+		threads.push_back(std::thread(&WorkStealingPool<T>::work, this, i));
+	}
+}
+
+template<class T> void WorkStealingPool<T>::join() {
+	for (size_t i = 0; i < threads.size(); ++i) {
+		threads[i].join();
+	}
+	threads.clear();
+	if (error) {
+		std::rethrow_exception(error);
+	}
+}
+
+template<class T> void WorkStealingPool<T>::work(size_t workerId) {
+	Worker &worker = *workers[workerId];
+	auto begin = std::chrono::steady_clock::now();
+	try {
+		T task;
+		while (!stopped) {
+			bool stolen = false;
+			if (!popOwn(workerId, task)) {
+				stolen = steal(workerId, task);
+				if (!stolen && !refillOwn(workerId, task)) {
+					break;
+				}
+			}
+			auto taskBegin = std::chrono::steady_clock::now();
+			processTask(task, workerId);
+			worker.busySeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - taskBegin).count();
+			worker.numTasks++;
+			if (stolen) {
+				worker.numStolenTasks++;
+			}
+		}
+	} catch (...) {
+		std::lock_guard<std::mutex> lck(errorMtx);
+		if (!error) {
+			error = std::current_exception();
+		}
+		stopped = true;
+	}
+	double runningSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+	worker.idleSeconds = std::max(runningSeconds - worker.busySeconds, 0.0);
+}
+
+template<class T> bool WorkStealingPool<T>::popOwn(size_t workerId, T &task) {
+	Worker &worker = *workers[workerId];
+	std::lock_guard<std::mutex> lck(worker.mtx);
+	if (worker.tasks.empty()) {
+		return false;
+	}
+	task = std::move(worker.tasks.front());
+	worker.tasks.pop_front();
+	return true;
+}
+
+// The victims are tried round-robin, starting with the next worker, so that thieves spread over the workers.
+template<class T> bool WorkStealingPool<T>::steal(size_t workerId, T &task) {
+	for (size_t i = 1; i < workers.size(); ++i) {
+		Worker &victim = *workers[(workerId + i) % workers.size()];
+		std::lock_guard<std::mutex> lck(victim.mtx);
+		if (!victim.tasks.empty()) {
+			task = std::move(victim.tasks.back());
+			victim.tasks.pop_back();
+			return true;
+		}
+	}
+	return false;
+}
+
+// Returns the first of the new tasks and puts the others into the deque of the worker, where the other workers can
+// steal them. Another worker may have refilled while this one waited for the lock, so it tries to steal first.
+template<class T> bool WorkStealingPool<T>::refillOwn(size_t workerId, T &task) {
+	std::lock_guard<std::mutex> lck(refillMtx);
+	std::vector<T> newTasks;
+	while (newTasks.empty()) {
+		if (steal(workerId, task)) {
+			workers[workerId]->numStolenTasks++;
+			return true;
+		}
+		if (sourceExhausted || stopped) {
+			return false;
+		}
+		sourceExhausted = !refillTasks(newTasks, workerId);
+	}
+	task = std::move(newTasks[0]);
+	Worker &worker = *workers[workerId];
+	std::lock_guard<std::mutex> lckWorker(worker.mtx);
+	for (size_t i = 1; i < newTasks.size(); ++i) {
+		worker.tasks.push_back(std::move(newTasks[i]));
+	}
+	return true;
+}
+
+template<class T> size_t WorkStealingPool<T>::getNumWorkers() const {
+	return workers.size();
+}
+
+// only valid after join()
+template<class T> double WorkStealingPool<T>::getBusySeconds(size_t workerId) const {
+	return workers[workerId]->busySeconds;
+}
+
+// only valid after join()
+template<class T> double WorkStealingPool<T>::getIdleSeconds(size_t workerId) const {
+	return workers[workerId]->idleSeconds;
+}
+
+template<class T> size_t WorkStealingPool<T>::getNumTasks(size_t workerId) const {
+	return workers[workerId]->numTasks;
+}
+
+template<class T> size_t WorkStealingPool<T>::getNumStolenTasks(size_t workerId) const {
+	return workers[workerId]->numStolenTasks;
+}
+
+// The workers are balanced if their busy times are close to each other.
+template<class T> void WorkStealingPool<T>::printStatistics(const std::string &name) const {
+	double minBusy = 0;
+	double maxBusy = 0;
+	for (size_t i = 0; i < workers.size(); ++i) {
+		const Worker &worker = *workers[i];
+		std::cout << name << " worker " << i << ": busy " << worker.busySeconds << " s, idle " << worker.idleSeconds
+				<< " s, " << worker.numTasks << " tasks (" << worker.numStolenTasks << " stolen)\n";
+		minBusy = (i == 0) ? worker.busySeconds : std::min(minBusy, worker.busySeconds);
+		maxBusy = std::max(maxBusy, worker.busySeconds);
+	}
+	std::cout << name << " busy time per worker: min " << minBusy << " s, max " << maxBusy << " s\n";
+}
@@ -64,7 +64,8 @@ void processDataset(Dataset &ds) {
 	// train error profile
 	cs.trainErrorProfile();
 
-	// correct reads
+	// correct reads, optionally each distinct read only once, which keeps the corrections of up to 2^24 reads in memory
+	//cs.enableReadDeduplication(ReadDeduplicationMode::SEQUENCE_AND_QUALITY);
 	cs.correctReads();
 
 	/*
@@ -79,6 +80,11 @@ void processDataset(Dataset &ds) {
 	//cs.experimentAllCoverageBiases();
 	//cs.experimentAllKmerClassifiers();
 	//cs.experimentAllErrorProfiles();
+	//cs.experimentBatchedCounting();
+	//cs.experimentFMIndexVariants(ds.readsFileName);
+#ifdef PAEC_COUNT_ALLOCATIONS
+	cs.experimentCandidateAllocations();
+#endif
 }
 
 int main() {
@@ -88,6 +88,12 @@ class classifier:
 
   def read_data(self, input_file):
     print("Reading data...")
+    if input_file.endswith(".npy"):
+        # array of records with one field per column, written by KmerClassificationUnit::writeTrainingData
+        data = np.load(input_file, mmap_mode = 'r')
+        X = np.column_stack([data[f] for f in self.features])
+        Y = data['type'].astype(int)
+        return (X, Y)
     df = pd.read_csv(input_file, header = 0, delimiter= ';')
     X = df[self.features].values
     Y = df['type'].values
@@ -207,6 +213,54 @@ class classifier:
       self.best_model = joblib.load(filename)
       print("Loaded classifier.")
 
+  #takes std::string
+  # Writes the best model in a plain text format that is evaluated natively by NativeKmerClassifier, so that
+  # classifying k-mers does not need the interpreter.
+  def export_model(self, filename):
+      model = self.best_model
+      out = open(filename, 'w')
+      out.write("paec_kmer_model 1\n")
+      if isinstance(model, naive):
+          out.write("type naive\n")
+      elif isinstance(model, statistical):
+          out.write("type statistical\n")
+      elif isinstance(model, GaussianNB):
+          out.write("type gaussian_nb\n")
+          self.write_classes(out, model.classes_)
+          out.write("prior " + " ".join(repr(float(p)) for p in model.class_prior_) + "\n")
+          for i in range(len(model.classes_)):
+              out.write("theta " + " ".join(repr(float(t)) for t in model.theta_[i]) + "\n")
+              out.write("sigma " + " ".join(repr(float(s)) for s in model.sigma_[i]) + "\n")
+      elif isinstance(model, LogisticRegression):
+          out.write("type logistic\n")
+          self.write_classes(out, model.classes_)
+          out.write("rows " + str(len(model.intercept_)) + "\n")
+          for i in range(len(model.intercept_)):
+              out.write("coef " + repr(float(model.intercept_[i])) + " " + " ".join(repr(float(c)) for c in model.coef_[i]) + "\n")
+      elif isinstance(model, DecisionTreeClassifier) or isinstance(model, RandomForestClassifier):
+          out.write("type tree_ensemble\n")
+          self.write_classes(out, model.classes_)
+          trees = [model] if isinstance(model, DecisionTreeClassifier) else model.estimators_
+          out.write("trees " + str(len(trees)) + "\n")
+          for estimator in trees:
+              tree = estimator.tree_
+              out.write("nodes " + str(tree.node_count) + "\n")
+              for node in range(tree.node_count):
+                  if tree.children_left[node] == -1:
+                      value = tree.value[node][0]
+                      proba = value / value.sum()
+                      out.write("leaf " + " ".join(repr(float(p)) for p in proba) + "\n")
+                  else:
+                      out.write("split " + str(tree.feature[node]) + " " + repr(float(tree.threshold[node])) + " " + str(tree.children_left[node]) + " " + str(tree.children_right[node]) + "\n")
+      else:
+          out.close()
+          raise ValueError("Cannot export model of type " + type(model).__name__)
+      out.close()
+      print("Exported classifier.")
+
+  def write_classes(self, out, classes):
+      out.write("classes " + str(len(classes)) + " " + " ".join(str(int(c)) for c in classes) + "\n")
+
   #takes std::vector<double> of size len(_features), returns std::vector<double> of size len(_classes)
   def proba(self, feature_vector):
     matrix = []
@@ -220,3 +274,7 @@ class classifier:
     matrix = []
     matrix.append(feature_vector)
     return self.best_model.predict(matrix)[0]
+
+  #takes a list of std::vector<double>, returns one int per feature vector
+  def classify_all(self, feature_matrix):
+    return [int(y) for y in np.ravel(self.best_model.predict(feature_matrix))]